@@ -0,0 +1,316 @@
+/* microbench.c
+ * Per-function microbenchmarks for the assembler's hot helpers.
+ * Each case runs warmup batches, then timed batches; reports median and p99
+ * nanoseconds per operation so regressions in a single path stand out.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "symbol_table.h"
+#include "instruction_set.h"
+#include "instruction_encoder.h"
+#include "first_pass.h"
+#include "memory_image.h"
+#include "error_list.h"
+#include "output_files.h"
+#include "alloc_stats.h"
+
+#define WARMUP_BATCHES 5
+#define TIMED_BATCHES  101
+#define TARGET_NS      2000000.0      /* aim for ~2 ms per batch */
+
+/* BenchFn — run `iters` operations of one case */
+typedef void (*BenchFn)(void *ctx, long iters);
+
+static volatile long g_sink;          /* defeats dead-code elimination */
+
+/* now_ns — monotonic clock in nanoseconds */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* cmp_double — qsort comparator */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* bench — calibrate batch size, warm up, time, print median/p99 ns/op */
+static void bench(const char *name, const char *size, BenchFn fn, void *ctx)
+{
+    double samples[TIMED_BATCHES];
+    long iters = 1;
+    int i;
+
+    /* grow the batch until it takes long enough to time reliably */
+    for (;;) {
+        double t0 = now_ns(), dt;
+        fn(ctx, iters);
+        dt = now_ns() - t0;
+        if (dt >= TARGET_NS / 4 || iters >= (1L << 24)) {
+            if (dt > 0) iters = (long)((double)iters * TARGET_NS / dt) + 1;
+            break;
+        }
+        iters *= 4;
+    }
+
+    for (i = 0; i < WARMUP_BATCHES; ++i) fn(ctx, iters);
+    for (i = 0; i < TIMED_BATCHES; ++i) {
+        double t0 = now_ns();
+        fn(ctx, iters);
+        samples[i] = (now_ns() - t0) / (double)iters;
+    }
+    qsort(samples, TIMED_BATCHES, sizeof(double), cmp_double);
+    printf("%-20s %-14s %12.1f %12.1f %10ld\n", name, size,
+           samples[TIMED_BATCHES / 2], samples[(TIMED_BATCHES * 99) / 100], iters);
+}
+
+/* ---- find_symbol -------------------------------------------------------- */
+
+typedef struct { Symbol *head; char (*names)[MAX_LABEL_LEN]; int n; } SymCtx;
+
+static void run_find_symbol(void *vctx, long iters)
+{
+    SymCtx *c = (SymCtx*)vctx;
+    long i, hits = 0;
+    for (i = 0; i < iters; ++i) hits += find_symbol(c->head, c->names[i % c->n]) != NULL;
+    g_sink = hits;
+}
+
+static void bench_find_symbol(int n)
+{
+    SymCtx c;
+    char size[32];
+    int i;
+    c.head = NULL;
+    c.n = n;
+    c.names = malloc((size_t)n * sizeof(*c.names));
+    if (!c.names) return;
+    for (i = 0; i < n; ++i) {
+        sprintf(c.names[i], "LABEL%d", i);
+        add_symbol(&c.head, c.names[i], 100 + i, SYMBOL_CODE);
+    }
+    /* look names up in a scrambled order so the walk length varies */
+    for (i = n - 1; i > 0; --i) {
+        char tmp[MAX_LABEL_LEN];
+        int j = (int)(((unsigned long)i * 2654435761UL) % (unsigned long)(i + 1));
+        strcpy(tmp, c.names[i]); strcpy(c.names[i], c.names[j]); strcpy(c.names[j], tmp);
+    }
+    sprintf(size, "%d syms", n);
+    bench("find_symbol", size, run_find_symbol, &c);
+    free_symbol_table(&c.head);
+    free(c.names);
+}
+
+/* ---- find_instruction --------------------------------------------------- */
+
+static void run_find_instruction(void *vctx, long iters)
+{
+    const char *name = (const char*)vctx;
+    long i, hits = 0;
+    for (i = 0; i < iters; ++i) hits += find_instruction(name) != NULL;
+    g_sink = hits;
+}
+
+/* ---- encode_instruction ------------------------------------------------- */
+
+typedef struct { MemoryImage *mem; Symbol *syms; ErrorList errors; const char **lines; int n; } EncCtx;
+
+static void run_encode(void *vctx, long iters)
+{
+    EncCtx *c = (EncCtx*)vctx;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        int k;
+        c->mem->IC = 0;
+        c->mem->fixup_count = 0;
+        for (k = 0; k < c->n; ++k)
+            encode_instruction(c->lines[k], c->syms, c->mem, &c->errors, k + 1);
+    }
+    g_sink = c->mem->IC;
+}
+
+static void bench_encode(MemoryImage *mem, int n)
+{
+    static const char *shapes[] = {
+        "mov r1, r2", "mov #5, r3", "mov MAT[r1][r2], r4", "cmp #7, r3",
+        "sub LABEL, r3", "lea LABEL, r5", "prn #-5", "jmp END", "rts", "stop"
+    };
+    EncCtx c;
+    char size[32];
+    int k;
+    c.mem = mem;
+    c.syms = NULL;
+    c.n = n;
+    add_symbol(&c.syms, "MAT", 0, SYMBOL_DATA);     /* labels the shapes refer to */
+    add_symbol(&c.syms, "LABEL", 100, SYMBOL_CODE);
+    add_symbol(&c.syms, "END", 120, SYMBOL_CODE);
+    init_error_list(&c.errors);
+    c.lines = malloc((size_t)n * sizeof(char*));
+    if (!c.lines) return;
+    for (k = 0; k < n; ++k) c.lines[k] = shapes[k % 10];
+    sprintf(size, "%d lines", n);
+    bench("encode_instruction", size, run_encode, &c);
+    if (c.errors.head) print_errors(&c.errors, "microbench", NULL);
+    free_error_list(&c.errors);
+    free_symbol_table(&c.syms);
+    free(c.lines);
+}
+
+/* ---- handle_data / handle_mat (through first_pass_line) ---------------- */
+
+typedef struct { MemoryImage *mem; Symbol *syms; ErrorList errors; const char *src; char *work; size_t len; } LineCtx;
+
+static void run_line(void *vctx, long iters)
+{
+    LineCtx *c = (LineCtx*)vctx;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        /* each iteration starts from an empty image: pass 1 also records
+         * a data span (and for code lines a statement) per line */
+        c->mem->DC = 0;
+        c->mem->span_count = 0;
+        while (c->mem->stmt_count > 0) as_free(c->mem->stmts[--c->mem->stmt_count].text);
+        memcpy(c->work, c->src, c->len + 1);
+        first_pass_line(c->work, 1, &c->syms, c->mem, &c->errors);
+    }
+    g_sink = c->mem->DC;
+}
+
+static void bench_line(const char *name, const char *size, MemoryImage *mem, const char *src)
+{
+    LineCtx c;
+    c.mem = mem;
+    c.syms = NULL;
+    c.src = src;
+    c.len = strlen(src);
+    c.work = malloc(c.len + 1);
+    init_error_list(&c.errors);
+    if (!c.work) return;
+    bench(name, size, run_line, &c);
+    if (c.errors.head) print_errors(&c.errors, "microbench", NULL);
+    free_error_list(&c.errors);
+    free(c.work);
+}
+
+/* data_line — ".data 0, 1, ..." with n values (malloc'd) */
+static char *data_line(int n)
+{
+    char *s = malloc((size_t)n * 8 + 16), *p;
+    int i;
+    if (!s) return NULL;
+    p = s + sprintf(s, ".data ");
+    for (i = 0; i < n; ++i) p += sprintf(p, i ? ", %d" : "%d", (i * 37) % 500 - 250);
+    return s;
+}
+
+/* mat_line — ".mat [r][c] v, v, ..." fully initialized (malloc'd) */
+static char *mat_line(int r, int c)
+{
+    char *s = malloc((size_t)(r * c) * 8 + 32), *p;
+    int i;
+    if (!s) return NULL;
+    p = s + sprintf(s, ".mat [%d][%d] ", r, c);
+    for (i = 0; i < r * c; ++i) p += sprintf(p, i ? ", %d" : "%d", i % 100);
+    return s;
+}
+
+/* ---- to_base4_letters --------------------------------------------------- */
+
+static void run_base4(void *vctx, long iters)
+{
+    int width = *(int*)vctx;
+    char out[16];
+    long i, acc = 0;
+    for (i = 0; i < iters; ++i) {
+        to_base4_letters((unsigned int)i, width, out);
+        acc += out[0];
+    }
+    g_sink = acc;
+}
+
+/* ---- add_error ---------------------------------------------------------- */
+
+static void run_add_error(void *vctx, long iters)
+{
+    int n = *(int*)vctx;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ErrorList list;
+        int k;
+        init_error_list(&list);
+        for (k = 0; k < n; ++k) add_error(&list, k, ERR_OPERAND_COUNT, "mov", 2, 3);
+        free_error_list(&list);
+    }
+    g_sink = n;
+}
+
+/* main — run every case; argument filters by case name substring */
+int main(int argc, char **argv)
+{
+    const char *only = argc > 1 ? argv[1] : NULL;
+    static const int sym_sizes[] = { 16, 256, 4096 };
+    static const int enc_sizes[] = { 1, 64, 1024 };
+    static const int data_sizes[] = { 1, 16, 256 };
+    static const int mat_dims[] = { 2, 8, 32 };
+    static const int widths[] = { 4, 5, 7 };
+    static const int err_sizes[] = { 1, 16, 256 };
+    static const char *mnemonics[] = { "mov", "prn", "stop", "nope" };
+    MemoryImage *mem = malloc(sizeof(MemoryImage));
+    char size[32];
+    int i;
+
+    if (!mem) return 1;
+    init_memory_image(mem);
+
+    printf("%-20s %-14s %12s %12s %10s\n", "case", "size", "median ns", "p99 ns", "iters");
+
+    if (!only || strstr("find_symbol", only))
+        for (i = 0; i < 3; ++i) bench_find_symbol(sym_sizes[i]);
+
+    if (!only || strstr("find_instruction", only))
+        for (i = 0; i < 4; ++i) bench("find_instruction", mnemonics[i], run_find_instruction, (void*)mnemonics[i]);
+
+    if (!only || strstr("encode_instruction", only))
+        for (i = 0; i < 3; ++i) bench_encode(mem, enc_sizes[i]);
+
+    if (!only || strstr("handle_data", only))
+        for (i = 0; i < 3; ++i) {
+            char *line = data_line(data_sizes[i]);
+            sprintf(size, "%d values", data_sizes[i]);
+            if (line) bench_line("handle_data", size, mem, line);
+            free(line);
+        }
+
+    if (!only || strstr("handle_mat", only))
+        for (i = 0; i < 3; ++i) {
+            char *line = mat_line(mat_dims[i], mat_dims[i]);
+            sprintf(size, "%dx%d", mat_dims[i], mat_dims[i]);
+            if (line) bench_line("handle_mat", size, mem, line);
+            free(line);
+        }
+
+    if (!only || strstr("to_base4_letters", only))
+        for (i = 0; i < 3; ++i) {
+            sprintf(size, "%d letters", widths[i]);
+            bench("to_base4_letters", size, run_base4, (void*)&widths[i]);
+        }
+
+    if (!only || strstr("add_error", only))
+        for (i = 0; i < 3; ++i) {
+            sprintf(size, "%d errors", err_sizes[i]);
+            bench("add_error", size, run_add_error, (void*)&err_sizes[i]);
+        }
+
+    free_memory_image(mem);
+    free(mem);
+    return 0;
+}
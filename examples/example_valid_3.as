@@ -1,5 +1,5 @@
 ; file: full_sweep_ok.as
-; Covers: all opcodes, imm/direct/matrix/register modes, entries/externs, data/string/mat
+; Covers: all opcodes, all addressing modes, entries/externs, data/string/mat
 
 .entry START
 .entry LEN
@@ -0,0 +1,43 @@
+/* alloc_stats.h
+ * Counting allocator wrapper used by all assembler modules.
+ * Tracks allocations, bytes and peak live bytes per assembler phase.
+ */
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* AllocPhase — pipeline stage that allocations are charged to */
+typedef enum {
+    PHASE_SETUP,                      /* per-file buffers (MemoryImage) */
+    PHASE_PRE,                        /* pre-assembler: macro bodies */
+    PHASE_PASS1,                      /* symbols, data, per-line copies */
+    PHASE_PASS2,                      /* encoding and fixup resolution */
+    PHASE_OUTPUT,                     /* .ob/.ent/.ext writing */
+    NUM_PHASES
+} AllocPhase;
+
+/* as_malloc — malloc that records the block size for accounting */
+void *as_malloc(size_t n);
+
+/* as_realloc — realloc for blocks from as_malloc (NULL p allowed) */
+void *as_realloc(void *p, size_t n);
+
+/* as_free — release a block from as_malloc/as_realloc (NULL allowed) */
+void as_free(void *p);
+
+/* as_set_phase — charge following allocations to phase */
+void as_set_phase(AllocPhase phase);
+
+/* as_reset_stats — zero per-phase counters (live bytes carry over) */
+void as_reset_stats(void);
+
+/* as_live_bytes — bytes currently allocated through as_malloc */
+size_t as_live_bytes(void);
+
+/* as_report — print per-phase table: allocs, frees, bytes, peak live */
+void as_report(FILE *out, const char *title);
+
+#endif /* ALLOC_STATS_H */
@@ -0,0 +1,48 @@
+/* asm_wire.h
+ * Framing between asmc and asmd over a Unix stream socket.
+ * A frame is "<tag> <length> <name>\n" followed by <length> raw bytes.
+ */
+
+#ifndef ASM_WIRE_H
+#define ASM_WIRE_H
+
+#include <stddef.h>
+
+#define WIRE_NAME_LEN  256
+#define WIRE_MAX_FRAME (64L * 1024 * 1024)
+
+/* client -> daemon */
+#define WIRE_CWD    'C'               /* payload: client working directory */
+#define WIRE_ARG    'A'               /* payload: one command-line argument */
+#define WIRE_SOURCE 'S'               /* name: file name; payload: source text */
+#define WIRE_RUN    'R'               /* end of request */
+
+/* daemon -> client */
+#define WIRE_STDOUT 'O'               /* payload: captured standard output */
+#define WIRE_STDERR 'E'               /* payload: captured diagnostics */
+#define WIRE_FILE   'F'               /* name: output file; payload: contents */
+#define WIRE_EXIT   'X'               /* payload: exit code in decimal */
+
+/* wire_output_exts — outputs returned for an inline source, NULL-terminated */
+extern const char *const wire_output_exts[];
+
+/* WireReader — buffered frame reader on a socket */
+typedef struct {
+    int    fd;
+    char   buf[4096];
+    size_t pos, len;
+} WireReader;
+
+/* wire_socket_path — $ASMD_SOCKET, else /tmp/asmd-<uid>.sock */
+void wire_socket_path(char *out, size_t outsz);
+
+/* wire_reader_init — attach a reader to fd */
+void wire_reader_init(WireReader *r, int fd);
+
+/* wire_send — write one frame; name may be NULL; 1 on success */
+int wire_send(int fd, int tag, const char *name, const char *data, size_t len);
+
+/* wire_recv — read one frame; *data is malloc'd and NUL-terminated; 1 on success */
+int wire_recv(WireReader *r, int *tag, char name[WIRE_NAME_LEN], char **data, size_t *len);
+
+#endif /* ASM_WIRE_H */
@@ -0,0 +1,27 @@
+/* assemble.h
+ * Runs the assembler pipeline on source files.
+ * Used by the assembler CLI and by asmd worker processes.
+ */
+
+#ifndef ASSEMBLE_H
+#define ASSEMBLE_H
+
+#include <stddef.h>
+#include "incremental.h"
+
+/* derive_source_name — arg with ".as" appended when it has no extension */
+void derive_source_name(const char *arg, char *out, size_t outsz);
+
+/* write_dependencies — <base>.d from the last pre_assemble's .include files */
+void write_dependencies(const char *src_path);
+
+/* assemble_file — pre-assemble, pass 1, pass 2 for one source; 1 on success */
+int assemble_file(const char *arg, int mem_stats);
+
+/* assemble_source — as assemble_file; on success the run is kept in keep (may be NULL) */
+int assemble_source(const char *arg, int mem_stats, IncState *keep);
+
+/* assembler_main — full command line (options apply to later files); exit code */
+int assembler_main(int argc, char **argv);
+
+#endif /* ASSEMBLE_H */
@@ -1,33 +1,122 @@
 /* error_list.h
- * Linked list of errors with line numbers.
- * Used by passes to collect and report issues.
+ * Linked list of coded errors with line numbers. Arguments are stored as
+ * given and the message is formatted only when it is printed.
  */
 
 #ifndef ERROR_LIST_H
 #define ERROR_LIST_H
 
-#define ERROR_MSG_LEN 100
+#include <stdio.h>
+#include <stddef.h>
 
-/* One error node (line + message) */
+/* ErrorCode — one per message; the text (and argument types) live in
+ * error_list.c. Arguments are passed to add_error in format order. */
+typedef enum {
+    ERR_OUT_OF_MEMORY,
+    ERR_CANNOT_OPEN,                  /* %s: path */
+    ERR_MEMORY_OVERFLOW,
+    ERR_INTERNAL,                     /* %s: function */
+
+    /* pre-assembler */
+    ERR_PRE_ASSEMBLE,                 /* %s: what failed */
+    ERR_LINE_TOO_LONG,                /* %d: limit */
+    ERR_EXPANSION_TOO_LONG,           /* %d: limit, %s: macro */
+    ERR_MACRO_DEF,                    /* %s: what is wrong with the mcro line */
+    ERR_MACRO_RECURSION,              /* %s: macro */
+    ERR_MACRO_ARGS,                   /* %s: macro, %d: count, %s: plural */
+    ERR_TOO_MANY_MACROS,
+    ERR_UNTERMINATED_MACRO,
+    ERR_INCLUDE,                      /* %s: what is wrong with the include */
+    ERR_INCLUDE_OPEN,                 /* %s: path */
+    ERR_INCLUDE_READ,                 /* %s: path */
+    ERR_INCLUDE_MACRO,                /* %s: macro */
+    ERR_INCLUDED,                     /* %s: path, %d: line, %s: its message */
+
+    /* first pass */
+    ERR_UNKNOWN_INSTRUCTION,          /* %s: mnemonic */
+    ERR_OPERAND_COUNT,                /* %s: mnemonic, %d: expected, %d: got */
+    ERR_INVALID_OPERAND,              /* %s: operand */
+    ERR_ADDRESSING_MODE,              /* %d: operand, %s: mnemonic */
+    ERR_MATRIX_OPERAND,               /* %s: operand */
+    ERR_LABEL_NO_STATEMENT,
+    ERR_LABEL_IGNORED,                /* %s: directive */
+    ERR_LABEL_EXTERN,                 /* %s: label */
+    ERR_DUPLICATE_LABEL,              /* %s: label */
+    ERR_DATA_LABEL_EXTERN,
+    ERR_DATA_LABEL_DUPLICATE,
+    ERR_EXTERN_DEFINED,               /* %s: symbol */
+    ERR_MISSING_SYMBOL,               /* %s: directive */
+    ERR_INVALID_SYMBOL,               /* %s: directive, %s: name */
+    ERR_BAD_INTEGER,                  /* %s: directive, %s: text */
+    ERR_TOO_MANY_VALUES,              /* %s: directive, %d: limit */
+    ERR_EXPECTED_COMMA,               /* %s: directive */
+    ERR_DATA_MISSING,
+    ERR_STRING_QUOTE,
+    ERR_MAT_SYNTAX,                   /* %s: what is wrong */
+    ERR_MAT_TOO_BIG,                  /* %ld: rows, %ld: cols */
+
+    /* second pass */
+    ERR_UNDEFINED_LABEL,              /* %s: label */
+
+    ERR_CODE_COUNT
+} ErrorCode;
+
+/* One error node: line, code and its arguments. Strings are copied into
+ * the same allocation, right after the node. */
 typedef struct ErrorNode {
     int line;
-    char message[ERROR_MSG_LEN];
+    ErrorCode code;
+    long num[2];                      /* numeric arguments, in order */
+    const char *str;                  /* string arguments, NUL-separated */
     struct ErrorNode *next;
 } ErrorNode;
 
-/* List container (head pointer) */
+/* List container (head pointer, newest first) */
 typedef struct {
     ErrorNode *head;
+    int count;                        /* nodes in the list */
+    int max;                          /* stop collecting at this many (0: no limit) */
+    unsigned char seen[32];           /* (line, code) hash bits for deduplication */
 } ErrorList;
 
-/* init_error_list — set list head to NULL */
+/* set_max_errors — limit for every list initialised from now on (0: none) */
+void set_max_errors(int max);
+
+/* init_error_list — empty list using the current limit */
 void init_error_list(ErrorList *list);
 
-/* add_error — append new error (line + message) */
-void add_error(ErrorList *list, int line, const char *msg);
+/* errors_full — 1 once the list has reached its limit; scans stop there */
+int errors_full(const ErrorList *list);
 
-/* print_and_clear_errors — dump errors and free list */
-void print_and_clear_errors(ErrorList *list);
+/* add_error — push error code with its arguments; a second error with the
+ * same (line, code) is dropped */
+void add_error(ErrorList *list, int line, ErrorCode code, ...);
 
-#endif
+/* push_error — put an existing node on top of list (merging lists) */
+void push_error(ErrorList *list, ErrorNode *node);
+
+/* splice_errors — move all of src's nodes on top of dst (src left empty) */
+void splice_errors(ErrorList *dst, ErrorList *src);
 
+/* trim_errors — drop the newest nodes above the limit */
+void trim_errors(ErrorList *list);
+
+/* print_error_message — the formatted message of one error */
+void print_error_message(FILE *out, const ErrorNode *e);
+
+/* format_error_message — same, into buf (always terminated, truncated) */
+void format_error_message(char *buf, size_t size, const ErrorNode *e);
+
+/* free_error_list — release all nodes without printing */
+void free_error_list(ErrorList *list);
+
+/* ErrorOrigin — maps an error's line to the file and line it came from;
+ * 0 (leaving them alone) when it cannot */
+typedef int (*ErrorOrigin)(int line, const char **file, int *line_out);
+
+/* print_errors — "[error] file:line: message" on stderr for each error in
+ * the order found, then a summary line; lines go through origin when it
+ * is given. Leaves the list reversed: free it afterwards. */
+void print_errors(ErrorList *list, const char *filename, ErrorOrigin origin);
+
+#endif
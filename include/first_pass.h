@@ -12,6 +12,12 @@
 
 #define MAX_LINE_LENGTH 80  /* spec: max line length */
 
+/* first_pass_line — parse one line (modified in place): symbols, data, IC */
+void first_pass_line(char *line, int line_no, Symbol **symtab, MemoryImage *mem, ErrorList *errors);
+
+/* set_pass1_jobs — threads for sizing large sources in line chunks (default 1) */
+void set_pass1_jobs(int jobs);
+
 /* first_pass — scans source, builds symbols & sizes code/data */
 int first_pass(const char *filename, Symbol **symtab, MemoryImage *mem, ErrorList *errors);
 
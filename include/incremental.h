@@ -0,0 +1,34 @@
+/* incremental.h
+ * Statement-level reassembly for --watch: keeps the last good run of a
+ * source and, when only plain instruction lines changed, re-sizes and
+ * re-encodes those alone, shifts what follows and patches outputs in place.
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "symbol_table.h"
+#include "memory_image.h"
+
+/* IncState — everything the next run needs from the last good one */
+typedef struct {
+    int valid;
+    char **lines;                     /* expanded (.am) lines, no newlines */
+    int line_count;
+    Symbol *symbols;                  /* final addresses */
+    MemoryImage *mem;                 /* code, data, statements, fixups */
+} IncState;
+
+/* inc_init — empty state */
+void inc_init(IncState *st);
+
+/* inc_free — drop the kept run */
+void inc_free(IncState *st);
+
+/* inc_capture — keep a finished run: reads am_path, takes *symbols and *mem */
+int inc_capture(IncState *st, const char *am_path, Symbol **symbols, MemoryImage **mem);
+
+/* reassemble — incremental when the edit allows it, else a full run; 1 on success */
+int reassemble(const char *arg, int mem_stats, IncState *st);
+
+#endif /* INCREMENTAL_H */
@@ -23,5 +23,12 @@ int encode_instruction(const char *line,
                        ErrorList *errors,
                        int line_num);
 
+/* encode_instruction_to — same, writing words/fixups through a CodeSink */
+int encode_instruction_to(const char *line,
+                          Symbol *symbols,
+                          CodeSink *out,
+                          ErrorList *errors,
+                          int line_num);
+
 #endif /* INSTRUCTION_ENCODER_H */
 
@@ -29,6 +29,9 @@ typedef struct {
 /* find_instruction — lookup by mnemonic, or NULL if not found */
 const Instruction* find_instruction(const char *name);
 
+/* instruction_by_opcode — entry for opcode 0..15, or NULL */
+const Instruction* instruction_by_opcode(int opcode);
+
 /* print_instruction_table — debug print of all instructions */
 void print_instruction_table(void);
 
@@ -0,0 +1,15 @@
+/* listing.h
+ * Listing file (.lst): each expanded source line beside the absolute
+ * addresses and base-4 words it produced.
+ */
+
+#ifndef LISTING_H
+#define LISTING_H
+
+#include "memory_image.h"
+
+/* write_listing_file — emit <base>.lst from the .am text, the pass-1 line
+ * maps (statements, data spans) and the final image */
+void write_listing_file(const char *src_filename, const char *am_path, const MemoryImage *mem);
+
+#endif /* LISTING_H */
@@ -8,38 +8,134 @@
 
 #include "symbol_table.h"
 
-#define MAX_CODE_SIZE 1024
-#define MAX_DATA_SIZE 1024
-#define MAX_FIXUPS    1024
+#define MAX_CODE_SIZE 4096
+#define MAX_DATA_SIZE 4096
+#define MAX_FIXUPS    4096
 
-/* Fixup — a placeholder for an unresolved symbol reference */
+/* MemoryModel — word and address geometry of the target machine.
+ * "classic" is the 10-bit course machine (8-bit address fields, 256 words);
+ * "wide" widens every word and the value field of extension words. */
 typedef struct {
-    int  word_index;                  /* code[] slot to patch */
-    char label[MAX_LABEL_LEN];        /* referenced symbol */
-    int  line;                        /* source line (for error reporting) */
-} Fixup;
+    const char *name;
+    int word_bits;                    /* width of one machine word */
+    int addr_bits;                    /* value field of an extension word */
+    int addr_digits;                  /* base-4 letters per address in output */
+    int word_digits;                  /* base-4 letters per word in output */
+    int mem_top;                      /* one past the highest usable address */
+} MemoryModel;
 
-/* MemoryImage — holds code, data, and fixups until output stage */
+/* Word — one stored machine word; no model is wider than 16 bits */
+typedef unsigned short Word;
+
+/* Statement — one instruction line as sized by pass 1 */
+typedef struct {
+    int   line;                       /* source line in the .am file */
+    int   ic;                         /* first code[] slot */
+    int   words;                      /* words reserved by pass 1 */
+    char *text;                       /* statement text after any label */
+} Statement;
+
+/* DataSpan — the data words one .data/.string/.mat line emitted */
 typedef struct {
-    int code[MAX_CODE_SIZE];
-    int data[MAX_DATA_SIZE];
+    int   line;                       /* source line in the .am file */
+    int   dc;                         /* first data[] slot */
+    int   words;
+    int   string;                     /* a .string literal (may be pooled) */
+} DataSpan;
+
+/* MemoryImage — holds code, data, and fixups until output stage.
+ * Fixups are kept as parallel arrays: fixup k patches code[fix_slot[k]]
+ * with the symbol whose id is fix_sym[k], referenced on line fix_line[k]. */
+typedef struct {
+    Word code[MAX_CODE_SIZE];
+    Word data[MAX_DATA_SIZE];
     int IC;                           /* count of code words */
     int DC;                           /* count of data words */
-    Fixup fixups[MAX_FIXUPS];
+    unsigned short fix_slot[MAX_FIXUPS];
+    int fix_sym[MAX_FIXUPS];          /* Symbol.id */
+    int fix_line[MAX_FIXUPS];
     int fixup_count;
+    const MemoryModel *model;         /* geometry used to mask and print words */
+    Statement *stmts;                 /* instruction statements from pass 1 */
+    int stmt_count;
+    int stmt_cap;
+    DataSpan *spans;                  /* data directives from pass 1, in line order */
+    int span_count;
+    int span_cap;
 } MemoryImage;
 
-/* init_memory_image — clear buffers and reset counters */
+/* CodeSink — encoder output: a window on code[] plus its own fixup arrays
+ * (laid out as in MemoryImage). Sinks on disjoint slot ranges may be
+ * filled concurrently. */
+typedef struct {
+    Word  *code;                      /* code[] of the target image */
+    int    ic;                        /* next slot to write */
+    const MemoryModel *model;
+    unsigned short *fix_slot;
+    int   *fix_sym;
+    int   *fix_line;
+    int    fixup_count;
+    int    fixup_cap;
+} CodeSink;
+
+/* default_memory_model — the classic 10-bit model */
+const MemoryModel *default_memory_model(void);
+
+/* find_memory_model — lookup model by name, or NULL if unknown */
+const MemoryModel *find_memory_model(const char *name);
+
+/* set_memory_model — select the model used by every new MemoryImage */
+void set_memory_model(const MemoryModel *model);
+
+/* init_memory_image — clear buffers, reset counters, attach current model */
 void init_memory_image(MemoryImage *m);
 
-/* add_code_word — append one code word (10-bit masked) */
+/* free_memory_image — release heap parts (statement and span lists) */
+void free_memory_image(MemoryImage *m);
+
+/* add_statement — record an instruction's IC slot and size (copies text) */
+int add_statement(MemoryImage *m, int line, int ic, int words, const char *text);
+
+/* add_data_span — record the data words a directive line emitted */
+int add_data_span(MemoryImage *m, int line, int dc, int words, int string);
+
+/* move_statements — append src's statements and data spans to dst with
+ * IC += ic_base, DC += dc_base (src left empty) */
+int move_statements(MemoryImage *dst, MemoryImage *src, int ic_base, int dc_base);
+
+/* sink_from_image — sink appending at m->IC into m's own fixup list */
+void sink_from_image(CodeSink *s, MemoryImage *m);
+
+/* sink_to_image — store an image-backed sink's counters back into m */
+void sink_to_image(const CodeSink *s, MemoryImage *m);
+
+/* alloc_sink_fixups — give a sink its own fixup arrays; 0 if out of memory */
+int alloc_sink_fixups(CodeSink *s, int cap);
+
+/* free_sink_fixups — release arrays from alloc_sink_fixups */
+void free_sink_fixups(CodeSink *s);
+
+/* sink_emit — write one word at s->ic (masked) and advance */
+void sink_emit(CodeSink *s, int word);
+
+/* sink_fixup — record a reference to symbol id sym for slot word_index */
+void sink_fixup(CodeSink *s, int word_index, int sym, int line);
+
+/* copy_fixup — append fixup k of src to dst, slot moved by ic_delta and
+ * line by line_delta; 0 if dst is full */
+int copy_fixup(CodeSink *dst, const CodeSink *src, int k, int ic_delta, int line_delta);
+
+/* add_code_word — append one code word (masked to model word width) */
 void add_code_word(MemoryImage *m, int word);
 
-/* add_data_word — append one data word (10-bit masked) */
+/* add_data_word — append one data word (masked to model word width) */
 void add_data_word(MemoryImage *m, int word);
 
-/* add_fixup — record a symbol reference to patch later in pass-2 */
-void add_fixup(MemoryImage *m, int word_index, const char *label, int line);
+/* add_data_fill — append count copies of one data word (e.g. a matrix's zero tail) */
+void add_data_fill(MemoryImage *m, int word, int count);
+
+/* add_fixup — record a reference to symbol id sym to patch later in pass-2 */
+void add_fixup(MemoryImage *m, int word_index, int sym, int line);
 
 #endif /* MEMORY_IMAGE_H */
 
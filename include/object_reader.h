@@ -0,0 +1,39 @@
+/* object_reader.h
+ * Reads back what write_output_files writes: <base>.ob into a MemoryImage and
+ * <base>.ent / <base>.ext into name/address tables. Files are memory-mapped
+ * and decoded in place; malformed lines are reported as [error] file:line.
+ */
+
+#ifndef OBJECT_READER_H
+#define OBJECT_READER_H
+
+#include "memory_image.h"
+#include "symbol_table.h"
+
+/* ObjRef — one "<name> <address>" line of a .ent or .ext file */
+typedef struct {
+    char name[MAX_LABEL_LEN];
+    int  address;                     /* absolute, as written */
+} ObjRef;
+
+/* ObjectFile — one assembled module */
+typedef struct {
+    MemoryImage mem;                  /* code[0..IC) from 100, then data[0..DC) */
+    ObjRef *ents;  int ent_count;     /* .ent lines (none if the file is absent) */
+    ObjRef *exts;  int ext_count;     /* .ext lines, one per extern use */
+} ObjectFile;
+
+/* read_object_image — parse a .ob into mem (reinitialised for mm); 1 on success */
+int read_object_image(const char *path, const MemoryModel *mm, MemoryImage *mem);
+
+/* read_object_refs — parse a .ent/.ext; a missing file gives no refs. Bad lines
+ * are reported and skipped (0 is returned); *refs is set either way. */
+int read_object_refs(const char *path, const MemoryModel *mm, ObjRef **refs, int *count);
+
+/* read_object_file — <base>.ob plus the optional <base>.ent/<base>.ext */
+int read_object_file(const char *base, const MemoryModel *mm, ObjectFile *obj);
+
+/* free_object_file — release the ref tables (and the image's lists) */
+void free_object_file(ObjectFile *obj);
+
+#endif /* OBJECT_READER_H */
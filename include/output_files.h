@@ -9,10 +9,24 @@
 #include "memory_image.h"
 #include "symbol_table.h"
 
+/* to_base4_letters — n as `width` letters a..d (+NUL) into out */
+void to_base4_letters(unsigned int n, int width, char *out);
+
+#define OUT_XREF 0x1                  /* also write <base>.xref */
+#define OUT_LST  0x2                  /* also write <base>.lst */
+
+/* set_output_extras / output_extras — OUT_* outputs beyond .ob/.ent/.ext */
+void set_output_extras(int flags);
+int output_extras(void);
+
+/* output_path — <base of src><ext> in the current directory (out: 300 bytes) */
+void output_path(const char *src_filename, const char *ext, char *out);
+
 /* of_init — reset extern-use tracking for a new file */
 void of_init(void);
 
-/* of_record_extern_use — record extern symbol use at absolute address */
+/* of_record_extern_use — record extern symbol use at absolute address
+ * (name is kept by pointer: it must live until the .ext file is written) */
 void of_record_extern_use(const char *name, int use_address);
 
 /* write_output_files — emit .ob/.ent/.ext files for assembled source */
@@ -20,5 +34,20 @@ void write_output_files(const char *src_filename,
                         const MemoryImage *mem,
                         const Symbol *symbols);
 
+/* write_entry_file — rewrite only the .ent file */
+void write_entry_file(const char *src_filename, const MemoryImage *mem, const Symbol *symbols);
+
+/* write_extern_file — rewrite only the .ext file from recorded extern uses */
+void write_extern_file(const char *src_filename, const MemoryImage *mem);
+
+/* write_dependency_file — make-style <base>.d: the .ob depends on the source
+ * and every file it included */
+void write_dependency_file(const char *src_filename, const char **deps, int ndeps);
+
+/* update_object_file — rewrite .ob lines in place: header (if set), words in
+ * slots[], and all words from tail_from on (-1: none); 0 if no .ob to update */
+int update_object_file(const char *src_filename, const MemoryImage *mem,
+                       int header, const int *slots, int nslots, int tail_from);
+
 #endif /* OUTPUT_FILES_H */
 
@@ -14,5 +14,14 @@ int pre_assemble(const char *src_path,
                  char *out_path, size_t out_path_sz,
                  ErrorList *errors);
 
+/* pre_assemble_deps — files pulled in by .include during the last
+ * pre_assemble, in first-use order; valid until the next run */
+int pre_assemble_deps(const char ***paths);
+
+/* pre_assemble_origin — the source or included file, and its line, that
+ * line am_line of the last .am came from (a macro call for its expansion);
+ * 0 if unknown. Valid until the next run. */
+int pre_assemble_origin(int am_line, const char **file, int *line);
+
 #endif /* PRE_ASSEMBLER_H */
 
@@ -1,5 +1,5 @@
 /* second_pass.h
- * Re-encodes instructions, resolves fixups with symbol table,
+ * Encodes pass-1 statements, resolves fixups with symbol table,
  * and writes output files (.ob/.ent/.ext).
  */
  
@@ -14,6 +14,12 @@
 #define MAX_LINE_LENGTH 80
 #endif
 
+/* set_pass2_jobs — threads for statement encoding (default 1) */
+void set_pass2_jobs(int jobs);
+
+/* fixup_word — code word for a resolved reference: address field | ARE (R or E) */
+int fixup_word(const MemoryModel *mm, const Symbol *sym);
+
 /* second_pass — encode code, resolve symbols, write outputs */
 int second_pass(const char *filename, Symbol **symbols,
                 MemoryImage *mem, ErrorList *errors);
@@ -0,0 +1,37 @@
+/* static_profile.h
+ * --profile-static: what a batch of sources uses of the instruction set,
+ * read from the encoded images (opcodes, mode pairs, packing, word totals).
+ */
+
+#ifndef STATIC_PROFILE_H
+#define STATIC_PROFILE_H
+
+#include <stdio.h>
+#include "instruction_set.h"
+#include "memory_image.h"
+
+#define PROFILE_NO_OPERAND 4          /* mode index for a missing operand */
+
+/* StaticProfile — counters summed over every image added */
+typedef struct {
+    int files;
+    int statements;
+    int code_words;
+    int data_words;
+    int fixups;                       /* symbol references patched in pass 2 */
+    int reg_reg_packed;               /* two register operands in one word */
+    int matrix_src, matrix_dst;       /* label[rX][rY] operands */
+    int opcodes[NUM_OPCODES];
+    int pairs[5][5];                  /* [src mode][dst mode], 4 = none */
+} StaticProfile;
+
+/* profile_reset — zero every counter */
+void profile_reset(StaticProfile *p);
+
+/* profile_image — add one assembled image (after pass 2) */
+void profile_image(StaticProfile *p, const MemoryImage *mem);
+
+/* write_profile — report as aligned text, or as one JSON object */
+void write_profile(FILE *out, const StaticProfile *p, int json);
+
+#endif /* STATIC_PROFILE_H */
@@ -0,0 +1,22 @@
+/* string_pool.h
+ * --pool-strings: .string literals that equal another literal, or end it,
+ * share that literal's words instead of being emitted again.
+ */
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include "symbol_table.h"
+#include "memory_image.h"
+
+/* set_pool_strings — turn pooling on for the runs that follow (0: off) */
+void set_pool_strings(int on);
+
+/* pool_strings_enabled — current setting */
+int pool_strings_enabled(void);
+
+/* pool_strings — drop duplicate/suffix literals from data[] (DC-relative,
+ * before the ICF bump) and re-point data labels and spans; words saved */
+int pool_strings(MemoryImage *mem, Symbol *symbols);
+
+#endif /* STRING_POOL_H */
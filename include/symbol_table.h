@@ -19,6 +19,8 @@ typedef struct Symbol {
     SymbolType type;
     int is_entry;
     int is_extern;
+    int line;                         /* definition (or .extern) line in the .am; 0: none */
+    int id;                           /* position in the table (fixups refer to it) */
     struct Symbol *next;
 } Symbol;
 
@@ -31,6 +33,10 @@ int add_symbol(Symbol **head, const char *name, int address, SymbolType type);
 /* find_symbol — lookup symbol by name, return pointer or NULL */
 Symbol *find_symbol(Symbol *head, const char *name);
 
+/* index_symbols — array of the table's symbols by id (as_free it); *count
+ * set to their number. NULL if the table is empty or out of memory. */
+Symbol **index_symbols(Symbol *head, int *count);
+
 /* print_symbol_table — debug print of all symbols */
 void print_symbol_table(Symbol *head);
 
@@ -0,0 +1,39 @@
+/* trace.h
+ * Timeline trace points, built in only with -DASM_TRACE (make TRACE=1).
+ * Each thread records begin/end events into its own ring buffer; --trace
+ * writes them as Chrome trace-event JSON (chrome://tracing, Perfetto).
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_RING_EVENTS 8192        /* per thread; the oldest are overwritten */
+#define TRACE_ARG_LEN     48
+
+/* trace_compiled_in — 1 if this build has the trace points */
+int trace_compiled_in(void);
+
+/* trace_start — start recording (events before this are not kept) */
+void trace_start(void);
+
+/* trace_dump — write every ring as {"traceEvents": [...]}; 1 on success */
+int trace_dump(const char *path);
+
+#ifdef ASM_TRACE
+
+/* trace_event — record one event: ph 'B' (begin) or 'E' (end); arg may be NULL */
+void trace_event(const char *name, char ph, const char *arg);
+
+#define TRACE_BEGIN(name)          trace_event((name), 'B', NULL)
+#define TRACE_BEGIN_ARG(name, arg) trace_event((name), 'B', (arg))
+#define TRACE_END(name)            trace_event((name), 'E', NULL)
+
+#else
+
+#define TRACE_BEGIN(name)          ((void)0)
+#define TRACE_BEGIN_ARG(name, arg) ((void)0)
+#define TRACE_END(name)            ((void)0)
+
+#endif /* ASM_TRACE */
+
+#endif /* TRACE_H */
@@ -0,0 +1,47 @@
+/* watch.h
+ * --watch: reassemble sources when their contents change on disk.
+ * Each file keeps the model, jobs, stats and extra-output settings it was given.
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "memory_image.h"
+#include "incremental.h"
+
+#define WATCH_PATH_LEN 512
+
+/* WatchItem — one watched source and what its last run saw */
+typedef struct {
+    char path[WATCH_PATH_LEN];        /* source path (with .as) */
+    const MemoryModel *model;         /* settings in effect for this file */
+    int jobs;
+    int mem_stats;
+    int extras;                       /* OUT_* optional outputs */
+    int max_errors;                   /* --max-errors (0: no limit) */
+    int pool_strings;                 /* --pool-strings */
+    long size;                        /* last assembled contents */
+    unsigned hash_a, hash_b;
+    int ok;                           /* last result */
+    IncState inc;                     /* last good run, for incremental rebuilds */
+    int wd;                           /* watch on the parent directory */
+    char **deps;                      /* files the last run .included */
+    int *dep_wd;                      /* watch on each one's directory */
+    int dep_count;
+    int dirty;
+} WatchItem;
+
+/* watch_record — fingerprint a source and remember its settings */
+void watch_record(WatchItem *item, const char *path, const MemoryModel *model,
+                  int jobs, int mem_stats, int extras, int max_errors, int pool_strings);
+
+/* watch_note_deps — remember the includes of the run that just finished */
+void watch_note_deps(WatchItem *item);
+
+/* watch_release — free an item's incremental state and include list */
+void watch_release(WatchItem *item);
+
+/* watch_sources — wait for changes and reassemble; returns only on error */
+int watch_sources(WatchItem *items, int count);
+
+#endif /* WATCH_H */
@@ -0,0 +1,15 @@
+/* xref.h
+ * Cross-reference index (.xref): every symbol with its definition and the
+ * code words that reference it, built from the symbol table and fixups.
+ */
+
+#ifndef XREF_H
+#define XREF_H
+
+#include "symbol_table.h"
+#include "memory_image.h"
+
+/* write_xref_file — emit <base>.xref for an assembled (fixups resolved) image */
+void write_xref_file(const char *src_filename, const MemoryImage *mem, const Symbol *symbols);
+
+#endif /* XREF_H */
@@ -0,0 +1,132 @@
+/* alloc_stats.c
+ * Counting allocator: every block carries a small size header so frees
+ * can be charged back; per-phase totals and peaks feed --mem-stats.
+ * Counters are guarded by a mutex because pass workers allocate too.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "alloc_stats.h"
+
+/* AllocHeader — prefix of every block, padded for maximal alignment */
+typedef union {
+    size_t size;
+    double d;
+    long   l;
+    void  *p;
+} AllocHeader;
+
+/* PhaseStats — counters for one phase */
+typedef struct {
+    unsigned long allocs;
+    unsigned long frees;
+    size_t bytes;                     /* total bytes requested */
+    size_t peak_live;                 /* highest live total seen in phase */
+} PhaseStats;
+
+static const char *g_phase_names[NUM_PHASES] = {
+    "setup", "pre-assembler", "pass 1", "pass 2", "output"
+};
+
+static PhaseStats g_stats[NUM_PHASES];
+static AllocPhase g_phase = PHASE_SETUP;
+static size_t     g_live = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* note_alloc — charge n bytes to the current phase */
+static void note_alloc(size_t n)
+{
+    PhaseStats *ps = &g_stats[g_phase];
+    ps->allocs++;
+    ps->bytes += n;
+    g_live += n;
+    if (g_live > ps->peak_live) ps->peak_live = g_live;
+}
+
+/* as_malloc — allocate n bytes behind a size header */
+void *as_malloc(size_t n)
+{
+    AllocHeader *h = (AllocHeader*)malloc(sizeof(AllocHeader) + n);
+    if (!h) return NULL;
+    h->size = n;
+    pthread_mutex_lock(&g_lock);
+    note_alloc(n);
+    pthread_mutex_unlock(&g_lock);
+    return h + 1;
+}
+
+/* as_realloc — resize, counted as a free of the old block plus an alloc */
+void *as_realloc(void *p, size_t n)
+{
+    AllocHeader *h, *nh;
+    size_t old;
+    if (!p) return as_malloc(n);
+    h = (AllocHeader*)p - 1;
+    old = h->size;
+    nh = (AllocHeader*)realloc(h, sizeof(AllocHeader) + n);
+    if (!nh) return NULL;
+    nh->size = n;
+    pthread_mutex_lock(&g_lock);
+    g_stats[g_phase].frees++;
+    g_live -= old;
+    note_alloc(n);
+    pthread_mutex_unlock(&g_lock);
+    return nh + 1;
+}
+
+/* as_free — release block and credit its bytes */
+void as_free(void *p)
+{
+    AllocHeader *h;
+    if (!p) return;
+    h = (AllocHeader*)p - 1;
+    pthread_mutex_lock(&g_lock);
+    g_stats[g_phase].frees++;
+    g_live -= h->size;
+    pthread_mutex_unlock(&g_lock);
+    free(h);
+}
+
+/* as_set_phase — switch the phase charged by later calls */
+void as_set_phase(AllocPhase phase)
+{
+    g_phase = phase;
+    if (g_live > g_stats[phase].peak_live) g_stats[phase].peak_live = g_live;
+}
+
+/* as_reset_stats — start a fresh accounting window */
+void as_reset_stats(void)
+{
+    int i;
+    for (i = 0; i < NUM_PHASES; ++i) {
+        g_stats[i].allocs = g_stats[i].frees = 0;
+        g_stats[i].bytes = g_stats[i].peak_live = 0;
+    }
+    g_phase = PHASE_SETUP;
+}
+
+/* as_live_bytes — bytes not yet freed */
+size_t as_live_bytes(void)
+{
+    return g_live;
+}
+
+/* as_report — per-phase table plus overall peak and live-at-end */
+void as_report(FILE *out, const char *title)
+{
+    int i;
+    size_t peak = 0;
+    unsigned long allocs = 0;
+    fprintf(out, "memory: %s\n", title);
+    fprintf(out, "  %-14s %8s %8s %12s %12s\n", "phase", "allocs", "frees", "bytes", "peak live");
+    for (i = 0; i < NUM_PHASES; ++i) {
+        fprintf(out, "  %-14s %8lu %8lu %12lu %12lu\n", g_phase_names[i],
+                g_stats[i].allocs, g_stats[i].frees,
+                (unsigned long)g_stats[i].bytes, (unsigned long)g_stats[i].peak_live);
+        allocs += g_stats[i].allocs;
+        if (g_stats[i].peak_live > peak) peak = g_stats[i].peak_live;
+    }
+    fprintf(out, "  total allocs %lu, peak live %lu bytes, live at end %lu bytes\n",
+            allocs, (unsigned long)peak, (unsigned long)g_live);
+}
@@ -0,0 +1,115 @@
+/* asm_wire.c
+ * Frame encoding and buffered decoding for the asmd/asmc socket protocol.
+ * Payload buffers use plain malloc: they cross per-file allocator windows.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "asm_wire.h"
+
+const char *const wire_output_exts[] = { ".ob", ".ent", ".ext", ".d", ".xref", ".lst", NULL };
+
+/* wire_socket_path — per-user default so daemons of different users coexist */
+void wire_socket_path(char *out, size_t outsz)
+{
+    const char *env = getenv("ASMD_SOCKET");
+    char tmp[64];
+    if (env && *env) {
+        strncpy(out, env, outsz - 1);
+        out[outsz - 1] = '\0';
+        return;
+    }
+    sprintf(tmp, "/tmp/asmd-%lu.sock", (unsigned long)getuid());
+    strncpy(out, tmp, outsz - 1);
+    out[outsz - 1] = '\0';
+}
+
+/* wire_reader_init — empty buffer on fd */
+void wire_reader_init(WireReader *r, int fd)
+{
+    r->fd = fd;
+    r->pos = r->len = 0;
+}
+
+/* write_all — write n bytes, retrying short writes */
+static int write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 1;
+}
+
+/* wire_send — header line then payload */
+int wire_send(int fd, int tag, const char *name, const char *data, size_t len)
+{
+    char hdr[WIRE_NAME_LEN + 32];
+    if (!name) name = "";
+    if (strlen(name) >= WIRE_NAME_LEN || strchr(name, '\n')) return 0;
+    sprintf(hdr, "%c %lu %s\n", tag, (unsigned long)len, name);
+    return write_all(fd, hdr, strlen(hdr)) && (len == 0 || write_all(fd, data, len));
+}
+
+/* fill — refill the buffer; 0 on EOF or error */
+static int fill(WireReader *r)
+{
+    ssize_t n;
+    do n = read(r->fd, r->buf, sizeof(r->buf)); while (n < 0 && errno == EINTR);
+    if (n <= 0) return 0;
+    r->pos = 0;
+    r->len = (size_t)n;
+    return 1;
+}
+
+/* get_byte — next byte, or -1 at EOF */
+static int get_byte(WireReader *r)
+{
+    if (r->pos == r->len && !fill(r)) return -1;
+    return (unsigned char)r->buf[r->pos++];
+}
+
+/* wire_recv — parse the header line, then copy the payload out */
+int wire_recv(WireReader *r, int *tag, char name[WIRE_NAME_LEN], char **data, size_t *len)
+{
+    char hdr[WIRE_NAME_LEN + 32];
+    size_t n = 0, got = 0;
+    unsigned long size;
+    char *sp;
+    int c;
+
+    while ((c = get_byte(r)) != '\n') {
+        if (c < 0 || n + 1 >= sizeof(hdr)) return 0;
+        hdr[n++] = (char)c;
+    }
+    hdr[n] = '\0';
+    if (n < 4 || hdr[1] != ' ') return 0;
+    size = strtoul(hdr + 2, &sp, 10);
+    if (*sp != ' ' || size > (unsigned long)WIRE_MAX_FRAME) return 0;
+    *tag = (unsigned char)hdr[0];
+    strcpy(name, sp + 1);
+
+    *data = (char *)malloc(size + 1);
+    if (!*data) return 0;
+    while (got < size) {
+        size_t take;
+        if (r->pos == r->len && !fill(r)) { free(*data); *data = NULL; return 0; }
+        take = r->len - r->pos;
+        if (take > size - got) take = size - got;
+        memcpy(*data + got, r->buf + r->pos, take);
+        r->pos += take;
+        got += take;
+    }
+    (*data)[size] = '\0';
+    *len = size;
+    return 1;
+}
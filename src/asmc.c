@@ -0,0 +1,235 @@
+/* asmc.c
+ * Thin client for asmd: takes the assembler's command line, runs it in the
+ * resident daemon, and relays its output and exit code. With no daemon
+ * listening the same job runs in-process, so asmc can stand in for assembler.
+ * --stdin NAME sends standard input as source NAME; outputs land in the cwd.
+ * The socket is $ASMD_SOCKET, else /tmp/asmd-<uid>.sock.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "assemble.h"
+#include "asm_wire.h"
+
+/* connect_daemon — open a stream to the daemon socket, or -1 */
+static int connect_daemon(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* read_stdin — all of standard input (malloc'd) */
+static char *read_stdin(size_t *len_out)
+{
+    char *buf = NULL;
+    size_t len = 0, cap = 0, got;
+
+    do {
+        if (len == cap) {
+            char *grown;
+            cap = cap ? cap * 2 : 65536;
+            grown = (char *)realloc(buf, cap);
+            if (!grown) { free(buf); return NULL; }
+            buf = grown;
+        }
+        got = fread(buf + len, 1, cap - len, stdin);
+        len += got;
+    } while (got > 0);
+    *len_out = len;
+    return buf;
+}
+
+/* send_request — cwd, arguments, optional inline source, run */
+static int send_request(int fd, int argc, char **argv)
+{
+    char cwd[4096];
+    int i;
+
+    if (!getcwd(cwd, sizeof(cwd))) return 0;
+    if (!wire_send(fd, WIRE_CWD, NULL, cwd, strlen(cwd))) return 0;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stdin") == 0 && i + 1 < argc) {
+            size_t len = 0;
+            char *text = read_stdin(&len);
+            int ok = text && wire_send(fd, WIRE_SOURCE, argv[++i], text, len);
+            free(text);
+            if (!ok) return 0;
+            continue;
+        }
+        if (!wire_send(fd, WIRE_ARG, NULL, argv[i], strlen(argv[i]))) return 0;
+    }
+    return wire_send(fd, WIRE_RUN, NULL, "", 0);
+}
+
+/* write_output — store a returned file under its plain name in the cwd */
+static void write_output(const char *name, const char *data, size_t len)
+{
+    FILE *fp;
+    if (!name[0] || strchr(name, '/')) return;
+    fp = fopen(name, "wb");
+    if (!fp) {
+        fprintf(stderr, "[error] cannot write %s\n", name);
+        return;
+    }
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+}
+
+/* read_file — whole file (malloc'd), or NULL if it does not exist */
+static char *read_file(const char *path, size_t *len_out)
+{
+    FILE *fp = fopen(path, "rb");
+    long n;
+    char *buf;
+
+    if (!fp) return NULL;
+    if (fseek(fp, 0L, SEEK_END) != 0 || (n = ftell(fp)) < 0) { fclose(fp); return NULL; }
+    buf = (char *)malloc((size_t)n + 1);
+    rewind(fp);
+    if (buf && fread(buf, 1, (size_t)n, fp) != (size_t)n) { free(buf); buf = NULL; }
+    fclose(fp);
+    *len_out = (size_t)n;
+    return buf;
+}
+
+/* run_inline — assemble standard input as src_name in a private directory,
+ * as asmd does, then move its outputs into the caller's directory */
+static int run_inline(int argc, char **argv, const char *src_name)
+{
+    char dir[] = "/tmp/asmc-job-XXXXXX";
+    char path[sizeof(dir) + WIRE_NAME_LEN + 8];
+    char *text, *dot;
+    size_t len = 0;
+    int i, home, rc = 1;
+    FILE *fp;
+
+    if (!src_name[0] || strchr(src_name, '/') || strlen(src_name) >= WIRE_NAME_LEN) {
+        fprintf(stderr, "[error] asmc: --stdin expects a plain file name\n");
+        return 1;
+    }
+    text = read_stdin(&len);
+    home = open(".", O_RDONLY);
+    if (!text || home < 0 || !mkdtemp(dir)) {
+        fprintf(stderr, "[error] asmc: cannot create job directory\n");
+        free(text);
+        if (home >= 0) close(home);
+        return 1;
+    }
+
+    sprintf(path, "%s/%s", dir, src_name);
+    fp = fopen(path, "wb");
+    if (!fp || fwrite(text, 1, len, fp) != len) fprintf(stderr, "[error] asmc: cannot write %s\n", src_name);
+    else if (chdir(dir) == 0) {
+        fclose(fp);
+        fp = NULL;
+        rc = assembler_main(argc, argv);
+        fflush(stdout);
+        if (fchdir(home) != 0) rc = 1;
+    }
+    if (fp) fclose(fp);
+    free(text);
+    remove(path);
+
+    /* the outputs asmd would send back, under their plain names */
+    dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) dot = path + strlen(path);
+    for (i = 0; wire_output_exts[i]; ++i) {
+        strcpy(dot, wire_output_exts[i]);
+        text = read_file(path, &len);
+        if (!text) continue;
+        write_output(strrchr(path, '/') + 1, text, len);
+        free(text);
+        remove(path);
+    }
+    rmdir(dir);
+    close(home);
+    return rc;
+}
+
+/* run_local — the job in this process: the assembler's own command line,
+ * with --stdin NAME turned into an inline source */
+static int run_local(int argc, char **argv)
+{
+    char **args = (char **)malloc(((size_t)argc + 2) * sizeof(char *));
+    const char *src_name = NULL;
+    int i, n = 0, rc;
+
+    if (!args) { fprintf(stderr, "[error] asmc: out of memory\n"); return 1; }
+    args[n++] = "assembler";
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stdin") == 0 && i + 1 < argc) src_name = argv[++i];
+        else args[n++] = argv[i];
+    }
+    if (src_name) {
+        args[n++] = (char *)src_name;
+        args[n] = NULL;
+        rc = run_inline(n, args, src_name);
+    } else {
+        args[n] = NULL;
+        rc = assembler_main(n, args);
+    }
+    free(args);
+    return rc;
+}
+
+/* main — forward the command line, replay the daemon's reply */
+int main(int argc, char **argv)
+{
+    char path[WIRE_NAME_LEN];
+    char name[WIRE_NAME_LEN];
+    WireReader r;
+    char *data;
+    size_t len;
+    int i, fd, tag, rc = 1;
+
+    for (i = 1; i < argc && strcmp(argv[i], "--watch") != 0; ++i) {}
+    if (argc < 2 || i < argc) {
+        printf("usage: %s [assembler options] <file> [file ...]\n"
+               "       %s [assembler options] --stdin NAME < source\n"
+               "Runs the job in asmd, or in-process when no daemon is listening.\n"
+               "--watch is not supported: use assembler --watch.\n", argv[0], argv[0]);
+        return argc < 2 ? 0 : 1;
+    }
+
+    wire_socket_path(path, sizeof(path));
+    fd = connect_daemon(path);
+    if (fd < 0) return run_local(argc, argv);
+    if (!send_request(fd, argc, argv)) {
+        fprintf(stderr, "[error] cannot send job to asmd\n");
+        close(fd);
+        return 2;
+    }
+
+    wire_reader_init(&r, fd);
+    while (wire_recv(&r, &tag, name, &data, &len)) {
+        if (tag == WIRE_STDOUT) fwrite(data, 1, len, stdout);
+        else if (tag == WIRE_STDERR) fwrite(data, 1, len, stderr);
+        else if (tag == WIRE_FILE) write_output(name, data, len);
+        else if (tag == WIRE_EXIT) rc = atoi(data);
+        free(data);
+        if (tag == WIRE_EXIT) break;
+    }
+    close(fd);
+    return rc;
+}
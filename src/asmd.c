@@ -0,0 +1,331 @@
+/* asmd.c
+ * Resident assembler. Pre-forks a pool of workers that accept jobs on a
+ * Unix socket, run the normal command line, and send back stdout, stderr,
+ * output files (for inline sources) and the exit code.
+ * Usage: asmd [--socket PATH] [--workers N]   (N = 0: one per CPU)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "assemble.h"
+#include "asm_wire.h"
+
+#define MAX_JOB_ARGS 256
+#define MAX_WORKERS  256
+
+/* Job — one decoded request */
+typedef struct {
+    char  *cwd;
+    char  *argv[MAX_JOB_ARGS + 3];    /* "assembler", args, inline name, NULL */
+    int    argc;
+    char  *src_name;                  /* inline source, or NULL */
+    char  *src_text;
+    size_t src_len;
+} Job;
+
+static volatile sig_atomic_t g_stop = 0;
+
+/* on_stop — SIGINT/SIGTERM in the parent: shut the pool down */
+static void on_stop(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+/* free_job — release every payload kept by read_job */
+static void free_job(Job *job)
+{
+    int i;
+    free(job->cwd);
+    for (i = 1; i < job->argc; ++i) free(job->argv[i]);
+    free(job->src_name);
+    free(job->src_text);
+}
+
+/* read_job — collect frames up to WIRE_RUN; 1 on a complete request */
+static int read_job(int fd, Job *job)
+{
+    WireReader r;
+    char name[WIRE_NAME_LEN];
+    char *data;
+    size_t len;
+    int tag;
+
+    memset(job, 0, sizeof(*job));
+    job->argv[job->argc++] = "assembler";
+    wire_reader_init(&r, fd);
+
+    while (wire_recv(&r, &tag, name, &data, &len)) {
+        switch (tag) {
+        case WIRE_CWD:
+            free(job->cwd);
+            job->cwd = data;
+            break;
+        case WIRE_ARG:
+            /* a watch never ends: it would hold the worker forever */
+            if (job->argc > MAX_JOB_ARGS || strcmp(data, "--watch") == 0) { free(data); return 0; }
+            job->argv[job->argc++] = data;
+            break;
+        case WIRE_SOURCE:
+            /* inline sources land in a private directory: plain names only */
+            if (!name[0] || strchr(name, '/') || job->src_name) { free(data); return 0; }
+            job->src_name = (char *)malloc(strlen(name) + 1);
+            if (!job->src_name) { free(data); return 0; }
+            strcpy(job->src_name, name);
+            job->src_text = data;
+            job->src_len = len;
+            break;
+        case WIRE_RUN:
+            free(data);
+            return 1;
+        default:
+            free(data);
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/* send_stream — rewind a capture file and send it as one frame */
+static int send_stream(int fd, int tag, const char *name, FILE *fp)
+{
+    long n;
+    char *buf;
+    int ok;
+
+    if (!fp || fseek(fp, 0L, SEEK_END) != 0 || (n = ftell(fp)) < 0) return 0;
+    if (n == 0) return tag == WIRE_FILE ? wire_send(fd, tag, name, "", 0) : 1;
+    buf = (char *)malloc((size_t)n);
+    if (!buf) return 0;
+    rewind(fp);
+    ok = fread(buf, 1, (size_t)n, fp) == (size_t)n && wire_send(fd, tag, name, buf, (size_t)n);
+    free(buf);
+    return ok;
+}
+
+/* send_outputs — return the outputs of an inline source, then delete */
+static void send_outputs(int fd, const char *src_name)
+{
+    char path[WIRE_NAME_LEN + 8];
+    char *dot;
+    int i;
+
+    strcpy(path, src_name);
+    dot = strrchr(path, '.');
+    if (dot) *dot = '\0';
+    dot = path + strlen(path);
+    for (i = 0; wire_output_exts[i]; ++i) {
+        FILE *fp;
+        strcpy(dot, wire_output_exts[i]);
+        fp = fopen(path, "rb");
+        if (!fp) continue;
+        send_stream(fd, WIRE_FILE, path, fp);
+        fclose(fp);
+        remove(path);
+    }
+}
+
+/* run_captured — assembler_main with fd 1/2 redirected into temp files */
+static int run_captured(Job *job, FILE *out, FILE *err)
+{
+    int save_out, save_err, rc;
+
+    fflush(stdout);
+    fflush(stderr);
+    save_out = dup(1);
+    save_err = dup(2);
+    dup2(fileno(out), 1);
+    dup2(fileno(err), 2);
+
+    job->argv[job->argc] = NULL;
+    rc = assembler_main(job->argc, job->argv);
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(save_out, 1);
+    dup2(save_err, 2);
+    close(save_out);
+    close(save_err);
+    return rc;
+}
+
+/* serve — handle one connection end to end */
+static void serve(int fd)
+{
+    Job job;
+    FILE *out, *err;
+    char tmpdir[] = "/tmp/asmd-job-XXXXXX";
+    char rc_text[16];
+    int rc = 1, inline_src = 0;
+
+    if (!read_job(fd, &job)) {
+        static const char msg[] = "[error] asmd: malformed request (or --watch, which needs a terminal)\n";
+        wire_send(fd, WIRE_STDERR, NULL, msg, sizeof(msg) - 1);
+        wire_send(fd, WIRE_EXIT, NULL, "1", 1);
+        free_job(&job);
+        return;
+    }
+
+    out = tmpfile();
+    err = tmpfile();
+    if (!out || !err) {
+        static const char msg[] = "[error] asmd: cannot create capture files\n";
+        wire_send(fd, WIRE_STDERR, NULL, msg, sizeof(msg) - 1);
+        goto reply;
+    }
+
+    if (job.src_name) {
+        FILE *fp;
+        if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0) {
+            fprintf(err, "[error] asmd: cannot create job directory\n");
+            goto reply;
+        }
+        inline_src = 1;
+        job.argv[job.argc++] = job.src_name;
+        job.src_name = NULL;          /* now owned by argv */
+        fp = fopen(job.argv[job.argc - 1], "wb");
+        if (!fp || fwrite(job.src_text, 1, job.src_len, fp) != job.src_len) {
+            if (fp) fclose(fp);
+            fprintf(err, "[error] asmd: cannot write %s\n", job.argv[job.argc - 1]);
+            goto reply;
+        }
+        fclose(fp);
+    } else if (!job.cwd || chdir(job.cwd) != 0) {
+        fprintf(err, "[error] asmd: cannot enter client directory\n");
+        goto reply;
+    }
+
+    rc = run_captured(&job, out, err);
+
+reply:
+    send_stream(fd, WIRE_STDOUT, NULL, out);
+    send_stream(fd, WIRE_STDERR, NULL, err);
+    if (inline_src) {
+        send_outputs(fd, job.argv[job.argc - 1]);
+        remove(job.argv[job.argc - 1]);
+        if (chdir("/") == 0) rmdir(tmpdir);
+    }
+    sprintf(rc_text, "%d", rc);
+    wire_send(fd, WIRE_EXIT, NULL, rc_text, strlen(rc_text));
+    if (out) fclose(out);
+    if (err) fclose(err);
+    free_job(&job);
+}
+
+/* worker_loop — child process: accept and serve until killed */
+static void worker_loop(int lfd)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    for (;;) {
+        int cfd = accept(lfd, NULL, NULL);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            _exit(1);
+        }
+        serve(cfd);
+        close(cfd);
+    }
+}
+
+/* spawn — fork one worker; returns its pid or -1 */
+static pid_t spawn(int lfd)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        worker_loop(lfd);
+        _exit(0);
+    }
+    return pid;
+}
+
+/* listen_on — bind a fresh socket at path, owner-only */
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(path, 0600) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* main — parse options, pre-fork the pool, respawn workers that exit */
+int main(int argc, char **argv)
+{
+    char path[WIRE_NAME_LEN];
+    pid_t pids[MAX_WORKERS];
+    struct sigaction sa;
+    int i, lfd, workers = 0;
+
+    wire_socket_path(path, sizeof(path));
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            strncpy(path, argv[++i], sizeof(path) - 1);
+            path[sizeof(path) - 1] = '\0';
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else {
+            printf("usage: %s [--socket PATH] [--workers N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0) workers = 1;
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+
+    lfd = listen_on(path);
+    if (lfd < 0) {
+        fprintf(stderr, "[error] asmd: cannot listen on %s\n", path);
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < workers; ++i) pids[i] = spawn(lfd);
+    fprintf(stderr, "asmd: %d workers on %s\n", workers, path);
+
+    while (!g_stop) {
+        int status;
+        pid_t dead = waitpid(-1, &status, 0);
+        if (dead < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (i = 0; i < workers; ++i)
+            if (pids[i] == dead && !g_stop) pids[i] = spawn(lfd);
+    }
+
+    for (i = 0; i < workers; ++i) if (pids[i] > 0) kill(pids[i], SIGTERM);
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR) {}
+    close(lfd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,250 @@
+/* assemble.c
+ * The assembler pipeline for one source (pre-assembler, pass 1, pass 2)
+ * and the command-line driver shared by the CLI and asmd workers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "assemble.h"
+#include "pre_assembler.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "symbol_table.h"
+#include "memory_image.h"
+#include "output_files.h"
+#include "listing.h"
+#include "error_list.h"
+#include "alloc_stats.h"
+#include "string_pool.h"
+#include "static_profile.h"
+#include "trace.h"
+#include "watch.h"
+#include "incremental.h"
+
+#define LOGICAL_BASE 100
+
+/* --profile-static: 0 off, 1 text, 2 JSON; summed over the batch */
+static int g_profile_format = 0;
+static StaticProfile g_profile;
+
+/* derive_source_name — ensure input ends with .as */
+void derive_source_name(const char *arg, char *out, size_t outsz) {
+    const char *dot = NULL, *p = arg;
+    size_t n = strlen(arg);
+    if (n >= outsz) n = outsz - 1;
+    memcpy(out, arg, n); out[n] = '\0';
+    for (p = out; *p; ++p) if (*p == '.') dot = p;
+    if (!dot) {
+        if (strlen(out) + 3 < outsz) strcat(out, ".as");
+    }
+}
+
+/* write_dependencies — <base>.d for the source and its .include files */
+void write_dependencies(const char *src_path)
+{
+    const char **deps;
+    int ndeps = pre_assemble_deps(&deps);
+    write_dependency_file(src_path, deps, ndeps);
+}
+
+/* assemble_file — run the full pipeline for one source; 1 on success */
+int assemble_file(const char *arg, int mem_stats)
+{
+    return assemble_source(arg, mem_stats, NULL);
+}
+
+/* assemble_source — full pipeline; a successful run is handed to keep */
+int assemble_source(const char *arg, int mem_stats, IncState *keep)
+{
+    char src_path[512];
+    char expanded_am[512] = {0};
+    ErrorList errors;
+    Symbol *symbols = NULL;
+    MemoryImage *mem;
+    int ok = 0;
+
+    derive_source_name(arg, src_path, sizeof(src_path));
+    TRACE_BEGIN_ARG("assemble", src_path);
+
+    as_reset_stats();
+    as_set_phase(PHASE_SETUP);
+    mem = (MemoryImage *)as_malloc(sizeof(MemoryImage));
+    if (!mem) {
+        fprintf(stderr, "[error] out of memory while processing %s\n", src_path);
+        TRACE_END("assemble");
+        return 0;
+    }
+
+    init_error_list(&errors);
+    init_symbol_table(&symbols);
+    init_memory_image(mem);
+
+    /* pre-assembler -> .am file */
+    as_set_phase(PHASE_PRE);
+    if (!pre_assemble(src_path, expanded_am, sizeof(expanded_am), &errors)) {
+        print_errors(&errors, src_path, NULL);
+        goto done;
+    }
+
+    /* first pass — builds symbol table & instruction skeletons */
+    as_set_phase(PHASE_PASS1);
+    if (!first_pass(expanded_am[0] ? expanded_am : src_path, &symbols, mem, &errors)) {
+        print_errors(&errors, src_path, pre_assemble_origin);
+        goto done;
+    }
+
+    /* memory must fit the model (addresses 0..255 in classic) */
+    if (LOGICAL_BASE + mem->IC + mem->DC > mem->model->mem_top) {
+        add_error(&errors, 0, ERR_MEMORY_OVERFLOW);
+        print_errors(&errors, src_path, NULL);
+        goto done;
+    }
+
+    /* second pass — resolves symbols & writes outputs */
+    as_set_phase(PHASE_PASS2);
+    if (!second_pass(src_path, &symbols, mem, &errors)) {
+        print_errors(&errors, src_path, pre_assemble_origin);
+        goto done;
+    }
+    ok = 1;
+    if (g_profile_format) profile_image(&g_profile, mem);
+    write_dependencies(src_path);
+    if ((output_extras() & OUT_LST) && expanded_am[0]) write_listing_file(src_path, expanded_am, mem);
+
+    /* keep symbols/image/expanded lines for the next incremental run */
+    if (keep && expanded_am[0] && !errors.head) inc_capture(keep, expanded_am, &symbols, &mem);
+
+done:
+    free_symbol_table(&symbols);
+    free_error_list(&errors);
+    if (expanded_am[0]) remove(expanded_am);
+    free_memory_image(mem);
+    as_free(mem);
+    if (mem_stats) as_report(stderr, src_path);
+    TRACE_END("assemble");
+    return ok;
+}
+
+/* assembler_main — the assembler command line: options and files in order */
+int assembler_main(int argc, char **argv)
+{
+    int i, ok, ok_all = 1, mem_stats = 0, jobs = 1, extras = 0, max_errors = 0, pool = 0;
+    int watch = 0, watched = 0;
+    const char *trace_path = NULL;
+    const MemoryModel *model = default_memory_model();
+    WatchItem *items = NULL;
+
+    /* every run starts from the defaults (asmd workers serve many runs) */
+    set_memory_model(model);
+    set_pass1_jobs(jobs);
+    set_pass2_jobs(jobs);
+    set_output_extras(extras);
+    set_max_errors(max_errors);
+    set_pool_strings(pool);
+    g_profile_format = 0;
+    profile_reset(&g_profile);
+
+    if (argc < 2) {
+        printf("usage: %s [--model classic|wide] [--mem-stats] [--jobs N] [--xref] [--lst] [--max-errors N] [--pool-strings] [--profile-static text|json] [--trace FILE] [--watch] <file> [file ...]\n", argv[0]);
+        return 0;
+    }
+
+    /* --watch is global; the items outlive every per-file allocator window */
+    for (i = 1; i < argc; ++i) if (strcmp(argv[i], "--watch") == 0) watch = 1;
+    if (watch) {
+        items = (WatchItem *)malloc((size_t)argc * sizeof(WatchItem));
+        if (!items) {
+            fprintf(stderr, "[error] out of memory\n");
+            return 1;
+        }
+    }
+
+    for (i = 1; i < argc; ++i) {
+        /* options may appear anywhere and apply to the files after them */
+        if (strcmp(argv[i], "--model") == 0) {
+            const MemoryModel *mm = (i + 1 < argc) ? find_memory_model(argv[i + 1]) : NULL;
+            if (!mm) {
+                fprintf(stderr, "[error] --model expects 'classic' or 'wide'\n");
+                return 1;
+            }
+            set_memory_model(mm);
+            model = mm;
+            ++i;
+            continue;
+        }
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            set_pass1_jobs(jobs);
+            set_pass2_jobs(jobs);
+            continue;
+        }
+        if (strcmp(argv[i], "--max-errors") == 0 && i + 1 < argc) {
+            max_errors = atoi(argv[++i]);
+            set_max_errors(max_errors);
+            continue;
+        }
+        if (strcmp(argv[i], "--profile-static") == 0) {
+            const char *fmt = (i + 1 < argc) ? argv[++i] : "";
+            if (strcmp(fmt, "text") == 0) g_profile_format = 1;
+            else if (strcmp(fmt, "json") == 0) g_profile_format = 2;
+            else {
+                fprintf(stderr, "[error] --profile-static expects 'text' or 'json'\n");
+                return 1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!trace_compiled_in()) {
+                fprintf(stderr, "[error] --trace needs a build with trace points (make TRACE=1)\n");
+                return 1;
+            }
+            trace_path = argv[++i];
+            trace_start();
+            continue;
+        }
+        if (strcmp(argv[i], "--pool-strings") == 0) {
+            pool = 1;
+            set_pool_strings(pool);
+            continue;
+        }
+        if (strcmp(argv[i], "--mem-stats") == 0) {
+            mem_stats = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--xref") == 0 || strcmp(argv[i], "--lst") == 0) {
+            extras |= argv[i][2] == 'x' ? OUT_XREF : OUT_LST;
+            set_output_extras(extras);
+            continue;
+        }
+        if (strcmp(argv[i], "--watch") == 0) continue;
+
+        if (watch) {
+            WatchItem *item = &items[watched++];
+            char src_path[WATCH_PATH_LEN];
+            derive_source_name(argv[i], src_path, sizeof(src_path));
+            watch_record(item, src_path, model, jobs, mem_stats, extras, max_errors, pool);
+            ok = item->ok = reassemble(argv[i], mem_stats, &item->inc);
+            watch_note_deps(item);
+        } else {
+            ok = assemble_file(argv[i], mem_stats);
+        }
+        if (!ok) ok_all = 0;
+    }
+
+    if (g_profile_format) {
+        write_profile(stdout, &g_profile, g_profile_format == 2);
+        fflush(stdout);
+    }
+    if (trace_path && !trace_dump(trace_path))
+        fprintf(stderr, "[error] --trace: cannot write %s\n", trace_path);
+
+    if (watch) {
+        if (watched > 0) watch_sources(items, watched);
+        for (i = 0; i < watched; ++i) watch_release(&items[i]);
+        free(items);
+        return 1;
+    }
+    return ok_all ? 0 : 1;
+}
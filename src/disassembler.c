@@ -0,0 +1,251 @@
+/* disassembler.c
+ * Turns a base-4 .ob image back into assembly text.
+ * The image is read by the shared object reader; instruction boundaries come from
+ * the first-word mode fields (layouts as in instruction_encoder.c). Optional
+ * .ent/.ext files next to the image are used to symbolize addresses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_image.h"
+#include "instruction_set.h"
+#include "addressing_modes.h"
+#include "object_reader.h"
+#include "alloc_stats.h"
+
+#define LOGICAL_BASE 100
+#define OUT_BUF_SIZE (1 << 16)
+
+enum { ARE_A = 0, ARE_E = 1, ARE_R = 2 };
+
+static const char *g_names[NUM_OPCODES] = {
+    "mov","cmp","add","sub","not","clr","lea","inc",
+    "dec","jmp","bne","red","prn","jsr","rts","stop"
+};
+
+/* operand count per opcode (order matches instruction_set.c) */
+static const int g_arity[NUM_OPCODES] = { 2,2,2,2,1,1,2,1, 1,1,1,1,1,1,0,0 };
+
+static const MemoryModel *g_model;
+
+/* ---- output buffer ------------------------------------------------------ */
+
+static char g_out[OUT_BUF_SIZE];
+static size_t g_out_len = 0;
+
+/* out_flush — write pending output */
+static void out_flush(void)
+{
+    fwrite(g_out, 1, g_out_len, stdout);
+    g_out_len = 0;
+}
+
+/* out_str — append a string */
+static void out_str(const char *s)
+{
+    size_t n = strlen(s);
+    if (g_out_len + n >= OUT_BUF_SIZE) out_flush();
+    memcpy(g_out + g_out_len, s, n);
+    g_out_len += n;
+}
+
+/* out_int — append a signed decimal */
+static void out_int(long v)
+{
+    char tmp[24];
+    int n = 0;
+    unsigned long u = (v < 0) ? (unsigned long)(-v) : (unsigned long)v;
+    do { tmp[n++] = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) tmp[n++] = '-';
+    if (g_out_len + (size_t)n >= OUT_BUF_SIZE) out_flush();
+    while (n) g_out[g_out_len++] = tmp[--n];
+}
+
+/* ---- image & symbols ---------------------------------------------------- */
+
+/* Image — decoded words plus address → name maps */
+typedef struct {
+    MemoryImage *mem;                 /* code[] from 100, data[] after it */
+    char **label_at;                  /* .ent name defined at address */
+    char **ext_at;                    /* .ext name used at word address */
+} Image;
+
+/* load_names — "<name> <address>" lines into a by-address table */
+static void load_names(const char *path, char **table)
+{
+    ObjRef *refs;
+    int i, n;
+
+    (void)read_object_refs(path, g_model, &refs, &n);  /* bad lines are reported and skipped */
+    for (i = 0; i < n; ++i) {
+        size_t len = strlen(refs[i].name);
+        char *name = (char*)malloc(len + 1);
+        if (!name) break;
+        memcpy(name, refs[i].name, len + 1);
+        free(table[refs[i].address]);
+        table[refs[i].address] = name;
+    }
+    as_free(refs);
+}
+
+/* ---- disassembly -------------------------------------------------------- */
+
+/* out_address_ref — symbolic name for an address word, else decimal */
+static void out_address_ref(const Image *img, int word_addr, int word)
+{
+    int value = word >> 2;
+    if ((word & 0x3) == ARE_E && img->ext_at[word_addr]) { out_str(img->ext_at[word_addr]); return; }
+    if ((word & 0x3) == ARE_R && value < g_model->mem_top && img->label_at[value]) {
+        out_str(img->label_at[value]);
+        return;
+    }
+    if ((word & 0x3) == ARE_E) out_str("?extern");
+    else out_int(value);
+}
+
+/* out_operand — print one operand, consuming its extension word(s) */
+static int out_operand(const Image *img, int mode, int is_src, int *pc, int end)
+{
+    int w, addr = *pc;
+    if (addr >= end) return 0;
+    w = img->mem->code[addr - LOGICAL_BASE];
+    (*pc)++;
+    switch (mode) {
+    case ADDR_IMMEDIATE: {
+        int v = w >> 2;
+        if (v & (1 << (g_model->addr_bits - 1))) v -= (1 << g_model->addr_bits);
+        out_str("#"); out_int(v);
+        break;
+    }
+    case ADDR_DIRECT:
+        out_address_ref(img, addr, w);
+        break;
+    case ADDR_MATRIX: {
+        int r;
+        out_address_ref(img, addr, w);
+        if (*pc >= end) return 0;
+        r = img->mem->code[*pc - LOGICAL_BASE];
+        (*pc)++;
+        out_str("[r"); out_int((r >> 6) & 0x7); out_str("][r"); out_int((r >> 2) & 0x7); out_str("]");
+        break;
+    }
+    default:
+        out_str("r"); out_int(is_src ? (w >> 6) & 0x7 : (w >> 2) & 0x7);
+        break;
+    }
+    return 1;
+}
+
+/* out_line_start — "<addr>  <label>:" column */
+static void out_line_start(const Image *img, int addr)
+{
+    const char *label = img->label_at[addr];
+    size_t n = 0;
+    out_int(addr);
+    out_str("  ");
+    if (label) { out_str(label); out_str(":"); n = strlen(label) + 1; }
+    for (; n < 10; ++n) out_str(" ");
+}
+
+/* disassemble — code section by instruction boundaries, then data */
+static void disassemble(const Image *img)
+{
+    int pc = LOGICAL_BASE, end = LOGICAL_BASE + img->mem->IC, i;
+
+    out_str("; code "); out_int(img->mem->IC);
+    out_str(" words, data "); out_int(img->mem->DC); out_str(" words\n");
+
+    while (pc < end) {
+        int w = img->mem->code[pc - LOGICAL_BASE];
+        int opcode = (w >> 6) & 0xF, src = (w >> 4) & 0x3, dst = (w >> 2) & 0x3;
+        int ok = 1;
+
+        out_line_start(img, pc);
+        pc++;
+        out_str(g_names[opcode]);
+        if (g_arity[opcode] == 2) {
+            out_str(" ");
+            if (src == ADDR_REGISTER && dst == ADDR_REGISTER && pc < end) {
+                int r = img->mem->code[pc - LOGICAL_BASE];
+                pc++;
+                out_str("r"); out_int((r >> 6) & 0x7); out_str(", r"); out_int((r >> 2) & 0x7);
+            } else {
+                ok = out_operand(img, src, 1, &pc, end);
+                out_str(", ");
+                if (ok) ok = out_operand(img, dst, 0, &pc, end);
+            }
+        } else if (g_arity[opcode] == 1) {
+            out_str(" ");
+            ok = out_operand(img, dst, 0, &pc, end);
+        }
+        if (!ok) out_str(" ; truncated");
+        out_str("\n");
+    }
+
+    for (i = 0; i < img->mem->DC; ++i) {
+        int addr = end + i, v = img->mem->data[i];
+        if (v & (1 << (g_model->word_bits - 1))) v -= (1 << g_model->word_bits);
+        out_line_start(img, addr);
+        out_str(".data "); out_int(v); out_str("\n");
+    }
+}
+
+/* disassemble_file — load <base>.ob (+ .ent/.ext) and print it */
+static int disassemble_file(const char *arg)
+{
+    char base[512], path[520];
+    const char *dot = strrchr(arg, '.'), *slash = strrchr(arg, '/');
+    size_t blen = (dot && (!slash || dot > slash)) ? (size_t)(dot - arg) : strlen(arg);
+    Image img;
+    int i, ok;
+
+    if (blen >= sizeof(base)) blen = sizeof(base) - 1;
+    memcpy(base, arg, blen); base[blen] = '\0';
+
+    memset(&img, 0, sizeof(img));
+    img.label_at = (char**)calloc((size_t)g_model->mem_top, sizeof(char*));
+    img.ext_at = (char**)calloc((size_t)g_model->mem_top, sizeof(char*));
+    if (!img.label_at || !img.ext_at) { free(img.label_at); free(img.ext_at); return 0; }
+
+    img.mem = (MemoryImage*)malloc(sizeof(MemoryImage));
+    if (!img.mem) { free(img.label_at); free(img.ext_at); return 0; }
+
+    sprintf(path, "%s.ob", base);
+    ok = read_object_image(path, g_model, img.mem);
+    if (ok) {
+        sprintf(path, "%s.ent", base);
+        load_names(path, img.label_at);
+        sprintf(path, "%s.ext", base);
+        load_names(path, img.ext_at);
+        disassemble(&img);
+        out_flush();
+    }
+
+    for (i = 0; i < g_model->mem_top; ++i) { free(img.label_at[i]); free(img.ext_at[i]); }
+    free(img.label_at); free(img.ext_at);
+    free_memory_image(img.mem);
+    free(img.mem);
+    return ok;
+}
+
+/* main — disassembler [--model M] image [image ...] */
+int main(int argc, char **argv)
+{
+    int i, files = 0, ok = 1;
+
+    g_model = default_memory_model();
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            g_model = find_memory_model(argv[++i]);
+            if (!g_model) { fprintf(stderr, "[error] --model expects 'classic' or 'wide'\n"); return 1; }
+            continue;
+        }
+        files++;
+        if (!disassemble_file(argv[i])) ok = 0;
+    }
+    if (files == 0) printf("usage: %s [--model classic|wide] <image[.ob]> [image ...]\n", argv[0]);
+    return ok ? 0 : 1;
+}
@@ -1,43 +1,306 @@
 /* error_list.c
- * Simple linked list of errors (line + message).
- * Add errors during passes; print and clear at the end.
+ * Simple linked list of coded errors (line + code + arguments).
+ * Add errors during passes; messages are formatted when printed.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include "error_list.h"
+#include "alloc_stats.h"
+
+#define MAX_ERROR_ARGS 2              /* of each kind: strings, numbers */
+
+/* message text per ErrorCode; conversions: %s %.Ns %d %ld */
+static const char *const g_messages[] = {
+    "out of memory",
+    "cannot open '%s'",
+    "memory overflow: code+data exceed the memory model",
+    "%s: invalid arguments",
+
+    "pre_assemble: %s",
+    "line too long (> %d chars)",
+    "line too long (> %d chars) in expansion of '%s'",
+    "mcro: %s",
+    "macro '%s' calls itself",
+    "macro '%s' expects %d argument%s",
+    "too many macros",
+    "unterminated macro (missing endmcro)",
+    "include: %s",
+    "include: cannot open '%s'",
+    "include: cannot read '%s'",
+    "include: duplicate macro '%s'",
+    "%s:%d: %s",
+
+    "unknown instruction '%s'",
+    "operand count mismatch for '%s' (expected %d, got %d)",
+    "invalid operand '%s'",
+    "illegal addressing mode for operand %d on '%s'",
+    "invalid matrix operand '%s'",
+    "label with no statement",
+    "label before %s is ignored",
+    "label '%s' cannot redefine extern",
+    "duplicate label '%s'",
+    ".data: label redefines extern",
+    ".data: duplicate label",
+    "%s: symbol '%s' already defined",
+    "%s: missing symbol name",
+    "%s: invalid name '%s'",
+    "%s: invalid integer near '%.40s'",
+    "%s: more than %d values",
+    "%s: expected comma",
+    ".data: missing numbers",
+    ".string: expected quoted string",
+    ".mat: %s",
+    ".mat: %ldx%ld cells do not fit in data memory",
+
+    "Undefined label: %s"
+};
+
+/* one message per code, in enum order */
+typedef char message_table_matches_codes[
+    (sizeof(g_messages) / sizeof(g_messages[0]) == ERR_CODE_COUNT) ? 1 : -1];
+
+static int g_max_errors = 0;
+
+/* set_max_errors — limit picked up by init_error_list */
+void set_max_errors(int max) {
+    g_max_errors = max > 0 ? max : 0;
+}
 
 /* init_error_list — set head to NULL */
 void init_error_list(ErrorList *list) {
     list->head = NULL;
+    list->count = 0;
+    list->max = g_max_errors;
+    memset(list->seen, 0, sizeof(list->seen));
+}
+
+/* errors_full — limit reached */
+int errors_full(const ErrorList *list) {
+    return list->max > 0 && list->count >= list->max;
+}
+
+/* seen_bit — bit of list->seen for (line, code) */
+static unsigned seen_bit(int line, ErrorCode code) {
+    return ((unsigned)line * 31u + (unsigned)code) & 255u;
+}
+
+/* mark_seen — note node's (line, code) */
+static void mark_seen(ErrorList *list, const ErrorNode *node) {
+    unsigned bit = seen_bit(node->line, node->code);
+    list->seen[bit >> 3] |= (unsigned char)(1u << (bit & 7));
 }
 
-/* add_error — push one error node (line, message) */
-void add_error(ErrorList *list, int line, const char *msg) {
-    ErrorNode *new_node = (ErrorNode *)malloc(sizeof(ErrorNode));
+/* already_reported — (line, code) is in the list; the bitmap answers
+ * most "no"s without a scan */
+static int already_reported(const ErrorList *list, int line, ErrorCode code) {
+    unsigned bit = seen_bit(line, code);
+    const ErrorNode *e;
+    if (!(list->seen[bit >> 3] & (1u << (bit & 7)))) return 0;
+    for (e = list->head; e; e = e->next)
+        if (e->line == line && e->code == code) return 1;
+    return 0;
+}
+
+/* add_error — push one coded error; ignored once full or when a duplicate */
+void add_error(ErrorList *list, int line, ErrorCode code, ...) {
+    const char *fmt, *strs[MAX_ERROR_ARGS];
+    size_t lens[MAX_ERROR_ARGS], total = 0;
+    long nums[MAX_ERROR_ARGS];
+    int ns = 0, nn = 0, k;
+    ErrorNode *new_node;
+    char *tail;
+    va_list ap;
+
+    if (errors_full(list) || (int)code < 0 || code >= ERR_CODE_COUNT)
+        return;
+    if (already_reported(list, line, code))
+        return;
+
+    /* collect the arguments the message's conversions ask for */
+    va_start(ap, code);
+    for (fmt = g_messages[code]; *fmt; ++fmt) {
+        if (*fmt != '%') continue;
+        ++fmt;
+        if (*fmt == '%') continue;
+        while (*fmt == '.' || (*fmt >= '0' && *fmt <= '9')) ++fmt;
+        if (*fmt == 's' && ns < MAX_ERROR_ARGS) {
+            strs[ns] = va_arg(ap, const char *);
+            if (!strs[ns]) strs[ns] = "";
+            lens[ns] = strlen(strs[ns]);
+            total += lens[ns] + 1;
+            ns++;
+        } else if (*fmt == 'l' && nn < MAX_ERROR_ARGS) {
+            nums[nn++] = va_arg(ap, long);
+            ++fmt;
+        } else if (*fmt == 'd' && nn < MAX_ERROR_ARGS) {
+            nums[nn++] = va_arg(ap, int);
+        }
+    }
+    va_end(ap);
+
+    new_node = (ErrorNode *)as_malloc(sizeof(ErrorNode) + total);
     if (!new_node)
         return; /* Out of memory, skip adding */
 
     new_node->line = line;
-    strncpy(new_node->message, msg, ERROR_MSG_LEN - 1);
-    new_node->message[ERROR_MSG_LEN - 1] = '\0';
-    new_node->next = list->head;
-    list->head = new_node;
+    new_node->code = code;
+    new_node->num[0] = nn > 0 ? nums[0] : 0;
+    new_node->num[1] = nn > 1 ? nums[1] : 0;
+    tail = (char *)(new_node + 1);
+    new_node->str = total ? tail : "";
+    for (k = 0; k < ns; ++k) {
+        memcpy(tail, strs[k], lens[k] + 1);
+        tail += lens[k] + 1;
+    }
+    push_error(list, new_node);
 }
 
-/* print_and_clear_errors — dump all errors and free nodes */
-void print_and_clear_errors(ErrorList *list) {
-    ErrorNode *curr = list->head;
-    if (!curr) {
-        return; /* No errors to print */
+/* push_error — node goes on top, counted and marked for deduplication */
+void push_error(ErrorList *list, ErrorNode *node) {
+    node->next = list->head;
+    list->head = node;
+    list->count++;
+    mark_seen(list, node);
+}
+
+/* splice_errors — src (newer) goes on top of dst, less what dst already has */
+void splice_errors(ErrorList *dst, ErrorList *src) {
+    ErrorNode *head = NULL, **link = &head, *e = src->head, *next;
+    size_t i;
+
+    for (; e; e = next) {
+        next = e->next;
+        if (already_reported(dst, e->line, e->code)) {
+            as_free(e);
+            src->count--;
+            continue;
+        }
+        *link = e;
+        link = &e->next;
+    }
+    *link = dst->head;
+    dst->head = head;
+    dst->count += src->count;
+    for (i = 0; i < sizeof(dst->seen); ++i) dst->seen[i] |= src->seen[i];
+    src->head = NULL;
+    src->count = 0;
+    memset(src->seen, 0, sizeof(src->seen));
+}
+
+/* trim_errors — keep only the oldest max nodes */
+void trim_errors(ErrorList *list) {
+    while (list->max > 0 && list->count > list->max) {
+        ErrorNode *newest = list->head;
+        list->head = newest->next;
+        as_free(newest);
+        list->count--;
+    }
+}
+
+/* MessageOut — where a message is formatted: a stream or a bounded buffer */
+typedef struct {
+    FILE *fp;
+    char *buf;
+    size_t size, len;
+} MessageOut;
+
+/* out_text — append n bytes of s */
+static void out_text(MessageOut *o, const char *s, size_t n) {
+    if (o->fp) { fwrite(s, 1, n, o->fp); return; }
+    if (o->len + 1 >= o->size) return;
+    if (n > o->size - 1 - o->len) n = o->size - 1 - o->len;
+    memcpy(o->buf + o->len, s, n);
+    o->len += n;
+    o->buf[o->len] = '\0';
+}
+
+/* emit_message — walk e's format, taking arguments from the node */
+static void emit_message(MessageOut *o, const ErrorNode *e) {
+    const char *fmt = g_messages[e->code], *s = e->str;
+    int nn = 0;
+
+    while (*fmt) {
+        const char *pct = strchr(fmt, '%');
+        long prec = -1;
+        if (!pct) { out_text(o, fmt, strlen(fmt)); break; }
+        out_text(o, fmt, (size_t)(pct - fmt));
+        fmt = pct + 1;
+        if (*fmt == '%') { out_text(o, "%", 1); ++fmt; continue; }
+        if (*fmt == '.') {
+            prec = 0;
+            for (++fmt; *fmt >= '0' && *fmt <= '9'; ++fmt) prec = prec * 10 + (*fmt - '0');
+        }
+        if (*fmt == 's') {
+            size_t n = strlen(s);
+            out_text(o, s, (prec >= 0 && n > (size_t)prec) ? (size_t)prec : n);
+            s += n + 1;
+        } else {
+            char num[24];
+            if (*fmt == 'l') ++fmt;
+            sprintf(num, "%ld", nn < MAX_ERROR_ARGS ? e->num[nn++] : 0L);
+            out_text(o, num, strlen(num));
+        }
+        if (*fmt) ++fmt;
     }
+}
+
+/* print_error_message — format straight to the stream */
+void print_error_message(FILE *out, const ErrorNode *e) {
+    MessageOut o;
+    o.fp = out; o.buf = NULL; o.size = o.len = 0;
+    emit_message(&o, e);
+}
 
+/* format_error_message — format into buf, truncating */
+void format_error_message(char *buf, size_t size, const ErrorNode *e) {
+    MessageOut o;
+    if (size == 0) return;
+    o.fp = NULL; o.buf = buf; o.size = size; o.len = 0;
+    buf[0] = '\0';
+    emit_message(&o, e);
+}
+
+/* free_error_list — release all nodes without printing */
+void free_error_list(ErrorList *list) {
+    ErrorNode *curr = list->head;
     while (curr) {
-        ErrorNode *temp = curr; /* C89 safe: declare temp before using */
-        printf("Error (line %d): %s\n", curr->line, curr->message);
+        ErrorNode *temp = curr;
         curr = curr->next;
-        free(temp);
+        as_free(temp);
     }
     list->head = NULL;
+    list->count = 0;
+    memset(list->seen, 0, sizeof(list->seen));
 }
 
+/* print_errors — each error in the order found, then a summary line */
+void print_errors(ErrorList *list, const char *filename, ErrorOrigin origin) {
+    ErrorNode *prev = NULL, *curr = list->head, *next;
+    const char *file;
+    int line;
+
+    /* the list is newest-first: reverse it in place (it is freed after this) */
+    while (curr) {
+        next = curr->next;
+        curr->next = prev;
+        prev = curr;
+        curr = next;
+    }
+    list->head = prev;
+
+    for (curr = list->head; curr; curr = curr->next) {
+        file = filename;
+        line = curr->line;
+        if (origin && line > 0) origin(line, &file, &line);
+        if (line > 0) fprintf(stderr, "[error] %s:%d: ", file, line);
+        else fprintf(stderr, "[error] %s: ", filename);
+        print_error_message(stderr, curr);
+        fputc('\n', stderr);
+    }
+    if (errors_full(list))
+        fprintf(stderr, "[error] %s: stopped after %d errors (--max-errors)\n", filename, list->count);
+    else
+        fprintf(stderr, "[error] %s: %d error(s)\n", filename, list->count);
+}
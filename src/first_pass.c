@@ -1,12 +1,16 @@
 /* first_pass.c
  * Pass 1: parse source, collect symbols/data, and compute code size (IC).
  * Validates labels/directives and infers addressing for sizing only.
+ * Large sources may be split into line chunks sized on separate threads.
  */
+
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
-#include <stdarg.h>
+#include <pthread.h>
 
 #include "first_pass.h"
 #include "instruction_set.h"
@@ -14,20 +18,18 @@
 #include "memory_image.h"
 #include "error_list.h"
 #include "addressing_modes.h"
+#include "alloc_stats.h"
+#include "string_pool.h"
+#include "trace.h"
 
 #define LOGICAL_BASE 100
 
-/* ---------- small helpers ---------- */
+/* chunks below this many source bytes are not worth a thread */
+#define MIN_BYTES_PER_JOB 16384
 
-/* add_err — printf-style add_error */
-static void add_err(ErrorList *errors, int line, const char *fmt, ...) {
-    char buf[ERROR_MSG_LEN];
-    va_list ap;
-    va_start(ap, fmt);
-    vsprintf(buf, fmt, ap);
-    va_end(ap);
-    add_error(errors, line, buf);
-}
+static int g_pass1_jobs = 1;
+
+/* ---------- small helpers ---------- */
 
 /* lstrip — skip leading spaces */
 static char *lstrip(char *s) { while (*s && isspace((unsigned char)*s)) s++; return s; }
@@ -48,7 +50,7 @@ static void strip_comment(char *s) { for(;*s;++s){ if(*s==';'){*s='\0'; break;}
 static int  is_blank(const char *s){ while(*s){ if(!isspace((unsigned char)*s)) return 0; s++; } return 1; }
 
 /* xstrdup — ANSI-safe strdup */
-static char *xstrdup(const char *s){ size_t n=strlen(s)+1; char *p=(char*)malloc(n); if(p) memcpy(p,s,n); return p; }
+static char *xstrdup(const char *s){ size_t n=strlen(s)+1; char *p=(char*)as_malloc(n); if(p) memcpy(p,s,n); return p; }
 
 /* split_commas_inplace — split into <=2 trimmed parts */
 static int split_commas_inplace(char *s, char *parts[], int max_parts) {
@@ -90,7 +92,7 @@ static int parse_string_literal(const char *s, unsigned char **out, size_t *out_
     while (*s && *s!='"') s++;
     if (*s != '"') return 0;
     n = (size_t)(s - start);
-    buf = (unsigned char*)malloc(n + 1);
+    buf = (unsigned char*)as_malloc(n + 1);
     if (!buf) return 0;
     for (i=0;i<n;i++) buf[i] = (unsigned char)start[i];
     buf[n] = 0;
@@ -211,87 +213,155 @@ static int compute_words(const Instruction *idef, AddrMode modes[], size_t nops)
     return words;
 }
 
-/* ---------- directives ---------- */
+/* ---------- symbol events ---------- */
+
+/* SymEventKind — every way a line can touch the symbol table */
+typedef enum { EV_DATA_LABEL, EV_DOT_DATA_LABEL, EV_CODE_LABEL, EV_EXTERN, EV_ENTRY } SymEventKind;
+
+/* SymEvent — one symbol-table update; value is the IC/DC at the line */
+typedef struct {
+    SymEventKind kind;
+    int line;
+    int value;
+    ErrorNode *after;                 /* newest error raised before it (chunks) */
+    char name[MAX_LABEL_LEN];
+} SymEvent;
+
+/* SymSink — applies events at once (symtab set) or records them for a chunk */
+typedef struct {
+    Symbol **symtab;
+    ErrorList *errors;
+    SymEvent *events;
+    int count, cap;
+} SymSink;
+
+/* define_symbol — add a symbol and note the line that defines it */
+static Symbol *define_symbol(Symbol **symtab, const char *name, int address, SymbolType type, int line){
+    Symbol *sym;
+    if (!add_symbol(symtab, name, address, type)) return NULL;
+    sym = find_symbol(*symtab, name);
+    if (sym) sym->line = line;
+    return sym;
+}
 
-/* bind_label_at_dc — if label exists, attach DC (DATA) */
-static void bind_label_at_dc(MemoryImage *mem, Symbol **symtab, ErrorList *errors, int line, const char *label_opt){
-    if (label_opt && *label_opt) {
-        Symbol *ex = find_symbol(*symtab, label_opt);
-        if (ex) {
-            if (ex->is_extern) add_err(errors,line,"label '%s' cannot redefine extern",label_opt);
-            else if (ex->address != 0) add_err(errors,line,"duplicate label '%s'",label_opt);
-            else { ex->address = mem->DC; ex->type = SYMBOL_DATA; }
-        } else add_symbol(symtab, label_opt, mem->DC, SYMBOL_DATA);
+/* apply_event — update the table as the sequential pass does; IC/DC rebased */
+static void apply_event(Symbol **symtab, ErrorList *errors, const SymEvent *ev, int ic_base, int dc_base){
+    Symbol *sym = find_symbol(*symtab, ev->name);
+
+    switch (ev->kind) {
+    case EV_DATA_LABEL:
+    case EV_CODE_LABEL:
+        if (sym) {
+            if (sym->is_extern) add_error(errors,ev->line,ERR_LABEL_EXTERN,ev->name);
+            else if (sym->address != 0) add_error(errors,ev->line,ERR_DUPLICATE_LABEL,ev->name);
+            else if (ev->kind == EV_CODE_LABEL) { sym->address = LOGICAL_BASE + ic_base + ev->value; sym->type = SYMBOL_CODE; sym->line = ev->line; }
+            else { sym->address = dc_base + ev->value; sym->type = SYMBOL_DATA; sym->line = ev->line; }
+        } else if (ev->kind == EV_CODE_LABEL) define_symbol(symtab, ev->name, LOGICAL_BASE + ic_base + ev->value, SYMBOL_CODE, ev->line);
+        else define_symbol(symtab, ev->name, dc_base + ev->value, SYMBOL_DATA, ev->line);
+        break;
+    case EV_DOT_DATA_LABEL:
+        if (sym) {
+            if (sym->is_extern) add_error(errors, ev->line, ERR_DATA_LABEL_EXTERN);
+            else if (sym->address != 0) add_error(errors, ev->line, ERR_DATA_LABEL_DUPLICATE);
+            else { sym->address = dc_base + ev->value; sym->type = SYMBOL_DATA; sym->line = ev->line; }
+        } else define_symbol(symtab, ev->name, dc_base + ev->value, SYMBOL_DATA, ev->line);
+        break;
+    case EV_EXTERN:
+        if (sym && sym->address != 0) { add_error(errors,ev->line,ERR_EXTERN_DEFINED,".extern",ev->name); break; }
+        if (!sym) sym = define_symbol(symtab, ev->name, 0, SYMBOL_CODE, ev->line);
+        if (sym) { sym->is_extern = 1; if (!sym->line) sym->line = ev->line; }
+        break;
+    case EV_ENTRY:
+        if (!sym) { add_symbol(symtab, ev->name, 0, SYMBOL_CODE); sym = find_symbol(*symtab, ev->name); }
+        if (sym) sym->is_entry = 1;
+        break;
     }
 }
 
-/* handle_data — parse unlimited comma-separated integers */
-static void handle_data(MemoryImage *mem, ErrorList *errors, Symbol **symtab, int line,
-                        const char *label_opt, char *args)
-{
-    char *p = args;
-    char *endp;
-    long v;
-
-    if (label_opt && *label_opt) {
-        Symbol *ex = find_symbol(*symtab, label_opt);
-        if (ex) {
-            if (ex->is_extern) add_error(errors, line, ".data: label redefines extern");
-            else if (ex->address != 0) add_error(errors, line, ".data: duplicate label");
-            else { ex->address = mem->DC; ex->type = SYMBOL_DATA; }
-        } else {
-            add_symbol(symtab, label_opt, mem->DC, SYMBOL_DATA);
+/* sym_event — apply now, or record for replay once chunk bases are known */
+static void sym_event(SymSink *syms, SymEventKind kind, int line, int value, const char *name){
+    SymEvent ev, *slot = &ev;
+
+    if (!syms->symtab) {
+        if (syms->count == syms->cap) {
+            int newcap = syms->cap ? syms->cap * 2 : 64;
+            SymEvent *grown = (SymEvent*)as_realloc(syms->events, (size_t)newcap * sizeof(SymEvent));
+            if (!grown) { add_error(syms->errors,line,ERR_OUT_OF_MEMORY); return; }
+            syms->events = grown;
+            syms->cap = newcap;
         }
+        slot = &syms->events[syms->count++];
     }
+    slot->kind = kind;
+    slot->line = line;
+    slot->value = value;
+    slot->after = syms->errors->head;
+    strncpy(slot->name, name, MAX_LABEL_LEN - 1);
+    slot->name[MAX_LABEL_LEN - 1] = '\0';
+
+    if (syms->symtab) apply_event(syms->symtab, syms->errors, slot, 0, 0);
+}
 
-    if (!args) { add_error(errors, line, ".data: missing numbers"); return; }
+/* ---------- directives ---------- */
 
+/* bind_label_at_dc — if label exists, attach DC (DATA) */
+static void bind_label_at_dc(MemoryImage *mem, SymSink *syms, int line, const char *label_opt){
+    if (label_opt && *label_opt) sym_event(syms, EV_DATA_LABEL, line, mem->DC, label_opt);
+}
+
+/* emit_int_list — stream "n, n, ..." straight into data[]; at most max values
+ * (-1: no limit). Number emitted, or -1 once an error was reported. */
+static int emit_int_list(MemoryImage *mem, ErrorList *errors, int line, const char *dir,
+                         const char *p, int max)
+{
+    int n = 0;
     for (;;) {
-        char msg[160];
+        char *endp;
+        long v;
 
-        /* skip leading spaces */
-        while (*p && isspace((unsigned char)*p)) p++;
-        if (*p == '\0') break;  /* no more items */
+        p = lstrip((char*)p);
+        if (*p == '\0') return n;                  /* no more items */
 
         v = strtol(p, &endp, 10);
-        if (endp == p) {
-            /* build the message explicitly (add_error is not printf-style) */
-            sprintf(msg, ".data: invalid integer near '%s'", p);
-            add_error(errors, line, msg);
-            return;
-        }
+        if (endp == p) { add_error(errors,line,ERR_BAD_INTEGER,dir,p); return -1; }
+        if (max >= 0 && n == max) { add_error(errors,line,ERR_TOO_MANY_VALUES,dir,max); return -1; }
         add_data_word(mem, (int)v);
+        ++n;
 
-        /* move past the parsed number and any spaces */
-        p = endp;
-        while (*p && isspace((unsigned char)*p)) p++;
-
-        if (*p == ',') { p++; continue; }      /* next value */
-        else if (*p == '\0') break;            /* end of list */
-        else {
-            add_error(errors, line, ".data: expected comma");
-            return;
-        }
+        p = lstrip(endp);
+        if (*p == ',') { p++; continue; }          /* next value */
+        if (*p == '\0') return n;                  /* end of list */
+        add_error(errors,line,ERR_EXPECTED_COMMA,dir);
+        return -1;
     }
 }
 
+/* handle_data — parse unlimited comma-separated integers */
+static void handle_data(MemoryImage *mem, ErrorList *errors, SymSink *syms, int line,
+                        const char *label_opt, char *args)
+{
+    if (label_opt && *label_opt) sym_event(syms, EV_DOT_DATA_LABEL, line, mem->DC, label_opt);
+
+    if (!args) { add_error(errors, line, ERR_DATA_MISSING); return; }
+    (void)emit_int_list(mem, errors, line, ".data", args, -1);
+}
+
 /* handle_string — emit bytes of quoted string (incl. NUL) */
-static void handle_string(MemoryImage *mem, ErrorList *errors, Symbol **symtab, int line,
+static void handle_string(MemoryImage *mem, ErrorList *errors, SymSink *syms, int line,
                           const char *label_opt, char *args){
     unsigned char *bytes = NULL;
     size_t n = 0, i;
 
-    bind_label_at_dc(mem, symtab, errors, line, label_opt);
+    bind_label_at_dc(mem, syms, line, label_opt);
 
-    if (!parse_string_literal(args, &bytes, &n)) { add_err(errors,line,".string: expected quoted string"); return; }
+    if (!parse_string_literal(args, &bytes, &n)) { add_error(errors,line,ERR_STRING_QUOTE); return; }
     for (i=0;i<n;i++) add_data_word(mem, (int)bytes[i]);
-    free(bytes);
+    as_free(bytes);
 }
 
 /* handle_extern — mark symbol as extern (create if needed) */
-static void handle_extern(Symbol **symtab, ErrorList *errors, int line, char *args){
+static void handle_extern(SymSink *syms, ErrorList *errors, int line, char *args){
     char name[MAX_LABEL_LEN]={0};
-    Symbol *existing;
 
     /* take first token as name */
     {
@@ -300,24 +370,15 @@ static void handle_extern(Symbol **symtab, ErrorList *errors, int line, char *ar
         while (args[i] && !isspace((unsigned char)args[i]) && i < MAX_LABEL_LEN-1) { name[i]=args[i]; i++; }
         name[i]='\0';
     }
-    if (!name[0]) { add_err(errors,line,".extern: missing symbol name"); return; }
-    if (!is_valid_label_name(name)) { add_err(errors,line,".extern: invalid name '%s'",name); return; }
+    if (!name[0]) { add_error(errors,line,ERR_MISSING_SYMBOL,".extern"); return; }
+    if (!is_valid_label_name(name)) { add_error(errors,line,ERR_INVALID_SYMBOL,".extern",name); return; }
 
-    existing = find_symbol(*symtab, name);
-    if (existing) {
-        if (existing->address != 0) { add_err(errors,line,".extern: symbol '%s' already defined",name); return; }
-        existing->is_extern = 1;
-    } else {
-        add_symbol(symtab, name, 0, SYMBOL_CODE);
-        existing = find_symbol(*symtab, name);
-        if (existing) existing->is_extern = 1;
-    }
+    sym_event(syms, EV_EXTERN, line, 0, name);
 }
 
 /* handle_entry — mark symbol as entry (create if needed) */
-static void handle_entry(Symbol **symtab, ErrorList *errors, int line, char *args){
+static void handle_entry(SymSink *syms, ErrorList *errors, int line, char *args){
     char name[MAX_LABEL_LEN]={0};
-    Symbol *sym;
 
     /* take first token as name */
     {
@@ -326,68 +387,44 @@ static void handle_entry(Symbol **symtab, ErrorList *errors, int line, char *arg
         while (args[i] && !isspace((unsigned char)args[i]) && i < MAX_LABEL_LEN-1) { name[i]=args[i]; i++; }
         name[i]='\0';
     }
-    if (!name[0]) { add_err(errors,line,".entry: missing symbol name"); return; }
-    if (!is_valid_label_name(name)) { add_err(errors,line,".entry: invalid name '%s'",name); return; }
-    sym = find_symbol(*symtab, name);
-    if (!sym) { add_symbol(symtab, name, 0, SYMBOL_CODE); sym = find_symbol(*symtab, name); }
-    if (sym) sym->is_entry = 1;
+    if (!name[0]) { add_error(errors,line,ERR_MISSING_SYMBOL,".entry"); return; }
+    if (!is_valid_label_name(name)) { add_error(errors,line,ERR_INVALID_SYMBOL,".entry",name); return; }
+    sym_event(syms, EV_ENTRY, line, 0, name);
 }
 
-/* handle_mat — parse .mat [R][C] + initializers (zero-fill) */
-static void handle_mat(MemoryImage *mem, ErrorList *errors, Symbol **symtab, int line,
+/* handle_mat — parse .mat [R][C] + initializers; the cells after them are zero */
+static void handle_mat(MemoryImage *mem, ErrorList *errors, SymSink *syms, int line,
                        const char *label_opt, char *args){
-    int R = 0, C = 0, total, i;
+    long R = 0, C = 0;
+    int n;
     char *p = args;
-    char *vals_dup = NULL;
-    char *parts[512];
-    int n = 0;
 
-    bind_label_at_dc(mem, symtab, errors, line, label_opt);
+    bind_label_at_dc(mem, syms, line, label_opt);
 
     p = lstrip(p);
-    if (*p != '[') { add_err(errors,line,".mat: expected [rows][cols]"); return; }
-    R = (int)strtol(p+1, &p, 10);
-    if (*p != ']') { add_err(errors,line,".mat: malformed rows"); return; }
+    if (*p != '[') { add_error(errors,line,ERR_MAT_SYNTAX,"expected [rows][cols]"); return; }
+    R = strtol(p+1, &p, 10);
+    if (*p != ']') { add_error(errors,line,ERR_MAT_SYNTAX,"malformed rows"); return; }
     p++;
     p = lstrip(p);
-    if (*p != '[') { add_err(errors,line,".mat: expected [cols]"); return; }
-    C = (int)strtol(p+1, &p, 10);
-    if (*p != ']') { add_err(errors,line,".mat: malformed cols"); return; }
+    if (*p != '[') { add_error(errors,line,ERR_MAT_SYNTAX,"expected [cols]"); return; }
+    C = strtol(p+1, &p, 10);
+    if (*p != ']') { add_error(errors,line,ERR_MAT_SYNTAX,"malformed cols"); return; }
     p++;
-    if (R <= 0 || C <= 0 || R > 64 || C > 64) { add_err(errors,line,".mat: invalid dimensions"); return; }
-    total = R * C;
-
-    /* optional initializer list after space/comma */
-    p = (char*)lstrip(p);
-    if (*p) {
-        vals_dup = xstrdup(p);
-        if (!vals_dup) { add_err(errors,line,"oom"); return; }
-        n = split_commas_inplace(vals_dup, parts, 512);
-    }
-
-    for (i=0; i<total; ++i) {
-        int v = 0;
-        if (i < n) {
-            char *tok = lstrip(parts[i]);
-            char *endp = NULL;
-            long lv;
-            if (*tok=='\0') { add_err(errors,line,".mat: empty value"); v = 0; }
-            else {
-                lv = strtol(tok, &endp, 10);
-                if (endp == tok || *lstrip(endp) != '\0') { add_err(errors,line,".mat: invalid integer '%s'", tok); v = 0; }
-                else v = (int)lv;
-            }
-        }
-        add_data_word(mem, v);
+    if (R <= 0 || C <= 0) { add_error(errors,line,ERR_MAT_SYNTAX,"invalid dimensions"); return; }
+    if (R > MAX_DATA_SIZE - mem->DC || C > (MAX_DATA_SIZE - mem->DC) / R) {
+        add_error(errors,line,ERR_MAT_TOO_BIG,R,C);
+        return;
     }
 
-    if (vals_dup) free(vals_dup);
+    n = emit_int_list(mem, errors, line, ".mat", p, (int)(R * C));
+    if (n >= 0) add_data_fill(mem, 0, (int)(R * C) - n);
 }
 
 /* ---------- instruction handling (sizing + label binding) ---------- */
 
 /* handle_instruction — parse mnemonic/ops, size words, bind label */
-static void handle_instruction(MemoryImage *mem, ErrorList *errors, Symbol **symtab, int line,
+static void handle_instruction(MemoryImage *mem, ErrorList *errors, SymSink *syms, int line,
                                const char *label_opt, char *cursor)
 {
     char mnemonic[16] = {0};
@@ -413,7 +450,7 @@ static void handle_instruction(MemoryImage *mem, ErrorList *errors, Symbol **sym
 
     idef = find_instruction(mnemonic);
     if (!idef) {
-        add_err(errors, line, "unknown instruction '%s'", mnemonic);
+        add_error(errors, line, ERR_UNKNOWN_INSTRUCTION, mnemonic);
         return;
     }
 
@@ -425,7 +462,7 @@ static void handle_instruction(MemoryImage *mem, ErrorList *errors, Symbol **sym
 
     opsbuf = xstrdup(s ? s : "");
     if (!opsbuf) {
-        add_err(errors, line, "out of memory");
+        add_error(errors, line, ERR_OUT_OF_MEMORY);
         return;
     }
 
@@ -438,42 +475,30 @@ static void handle_instruction(MemoryImage *mem, ErrorList *errors, Symbol **sym
     if (idef->operands == 1 && nops > 1) nops = 1;
 
     if (nops != idef->operands) {
-        add_err(errors, line, "operand count mismatch for '%s' (expected %d, got %d)",
-                mnemonic, idef->operands, nops);
+        add_error(errors, line, ERR_OPERAND_COUNT, mnemonic, idef->operands, nops);
         /* continue to compute size so IC stays consistent */
     }
 
     for (i = 0; i < nops; i++) {
         modes[i] = parse_operand_mode(ops[i]);
         if (modes[i] == AM_INVALID) {
-            add_err(errors, line, "invalid operand '%s'", ops[i]);
+            add_error(errors, line, ERR_INVALID_OPERAND, ops[i]);
         } else if (!mode_allowed(idef, i, modes[i])) {
-            add_err(errors, line, "illegal addressing mode for operand %d on '%s'", i, mnemonic);
+            add_error(errors, line, ERR_ADDRESSING_MODE, i, mnemonic);
         }
     }
 
     /* bind label to logical code address before sizing */
-    if (label_opt && *label_opt) {
-        Symbol *ex = find_symbol(*symtab, label_opt);
-        if (ex) {
-            if (ex->is_extern) {
-                add_err(errors, line, "label '%s' cannot redefine extern", label_opt);
-            } else if (ex->address != 0) {
-                add_err(errors, line, "duplicate label '%s'", label_opt);
-            } else {
-                ex->address = LOGICAL_BASE + mem->IC;
-                ex->type = SYMBOL_CODE;
-            }
-        } else {
-            add_symbol(symtab, label_opt, LOGICAL_BASE + mem->IC, SYMBOL_CODE);
-        }
-    }
+    if (label_opt && *label_opt) sym_event(syms, EV_CODE_LABEL, line, mem->IC, label_opt);
 
-    /* size only (words in code); add_code_word is NOT used in pass 1 */
+    /* size only (words in code); add_code_word is NOT used in pass 1.
+       The statement keeps its IC slot so pass 2 can encode it in place. */
     words = compute_words(idef, modes, (size_t)nops);
+    if (!add_statement(mem, line, mem->IC, words, lstrip(cursor)))
+        add_error(errors, line, ERR_OUT_OF_MEMORY);
     mem->IC += words;
 
-    free(opsbuf);
+    as_free(opsbuf);
 }
 
 /* ---------- end-of-pass helpers ---------- */
@@ -487,68 +512,244 @@ static void bump_data_symbols_by_icf(Symbol *head, int icf_words){
 
 /* ---------- entry point ---------- */
 
-/* first_pass — scan file, fill symtab/DC, and compute IC */
-int first_pass(const char *filename, Symbol **symtab, MemoryImage *mem, ErrorList *errors){
-    FILE *fp = fopen(filename, "r");
-    char linebuf[1024];
-    int line_no = 0;
+/* scan_line — classify one source line and run its handler */
+static void scan_line(char *linebuf, int line_no, SymSink *syms, MemoryImage *mem, ErrorList *errors){
+    char *cursor;
+    char label[MAX_LABEL_LEN]={0};
+    int has_label;
+    char tok[32]={0};
 
-    if (!fp) { add_err(errors,0,"cannot open '%s'",filename); return 0; }
+    strip_comment(linebuf);
+    trim_inplace(linebuf);
+    if (*linebuf == '\0') return;
 
-    while (fgets(linebuf, sizeof(linebuf), fp)) {
-        size_t raw_len;
-        char *cursor;
-        char label[MAX_LABEL_LEN]={0};
-        int has_label;
-        char tok[32]={0};
+    cursor = linebuf;
+    has_label = take_leading_label(&cursor, label);
 
-        line_no++;
+    /* first token after (optional) label */
+    {
+        int i=0; char *p = (char*)lstrip(cursor);
+        while (p[i] && !isspace((unsigned char)p[i]) && p[i] != ',' && i < (int)(sizeof(tok)-1)) { tok[i]=p[i]; i++; }
+        tok[i]='\0';
+    }
+    if (!tok[0]) {
+        if (has_label) add_error(errors,line_no,ERR_LABEL_NO_STATEMENT);
+        return;
+    }
 
-        raw_len = strcspn(linebuf, "\r\n");
-        if (raw_len > MAX_LINE_LENGTH) add_err(errors,line_no,"line too long (> 80 chars)");
+    if (is_directive_tok(tok)) {
+        int dc0 = mem->DC;
+        cursor = lstrip(cursor);
+        cursor += (int)strlen(tok);
+
+        if (strcmp(tok,".data")==0)
+            handle_data(mem,errors,syms,line_no,has_label?label:NULL,cursor);
+        else if (strcmp(tok,".string")==0)
+            handle_string(mem,errors,syms,line_no,has_label?label:NULL,cursor);
+        else if (strcmp(tok,".extern")==0) {
+            if (has_label) add_error(errors,line_no,ERR_LABEL_IGNORED,".extern");
+            handle_extern(syms,errors,line_no,cursor);
+        } else if (strcmp(tok,".entry")==0) {
+            if (has_label) add_error(errors,line_no,ERR_LABEL_IGNORED,".entry");
+            handle_entry(syms,errors,line_no,cursor);
+        } else if (strcmp(tok,".mat")==0) {
+            handle_mat(mem,errors,syms,line_no,has_label?label:NULL,cursor);
+        }
+        /* the listing's map of data lines */
+        if (mem->DC > dc0 && !add_data_span(mem, line_no, dc0, mem->DC - dc0, strcmp(tok,".string")==0))
+            add_error(errors,line_no,ERR_OUT_OF_MEMORY);
+    } else {
+        handle_instruction(mem,errors,syms,line_no,has_label?label:NULL,cursor);
+    }
+}
 
-        strip_comment(linebuf);
-        trim_inplace(linebuf);
-        if (*linebuf == '\0') continue;
+/* first_pass_line — classify one source line and run its handler */
+void first_pass_line(char *linebuf, int line_no, Symbol **symtab, MemoryImage *mem, ErrorList *errors){
+    SymSink syms;
+    syms.symtab = symtab;
+    syms.errors = errors;
+    syms.events = NULL;
+    syms.count = syms.cap = 0;
+    scan_line(linebuf, line_no, &syms, mem, errors);
+}
 
-        cursor = linebuf;
-        has_label = take_leading_label(&cursor, label);
+/* set_pass1_jobs — threads used to size line chunks (1 = sequential) */
+void set_pass1_jobs(int jobs){
+    g_pass1_jobs = (jobs < 1) ? 1 : jobs;
+}
 
-        /* first token after (optional) label */
-        {
-            int i=0; char *p = (char*)lstrip(cursor);
-            while (p[i] && !isspace((unsigned char)p[i]) && p[i] != ',' && i < (int)(sizeof(tok)-1)) { tok[i]=p[i]; i++; }
-            tok[i]='\0';
-        }
-        if (!tok[0]) {
-            if (has_label) add_err(errors,line_no,"label with no statement");
-            continue;
+/* next_line_len — bytes fgets(…, 1024, …) would return from p */
+static size_t next_line_len(const char *p, const char *end){
+    const char *nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    size_t n = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+    return n > 1023 ? 1023 : n;
+}
+
+/* scan_text — run scan_line over source bytes [p, end), numbering from line_no+1;
+ * stops early once the error list is full. Line length was checked by the
+ * pre-assembler. */
+static void scan_text(const char *p, const char *end, int line_no, SymSink *syms, MemoryImage *mem, ErrorList *errors){
+    char linebuf[1024];
+
+    while (p < end && !errors_full(errors)) {
+        size_t n = next_line_len(p, end);
+
+        memcpy(linebuf, p, n);
+        linebuf[n] = '\0';
+        p += n;
+        line_no++;
+
+        scan_line(linebuf, line_no, syms, mem, errors);
+    }
+}
+
+/* read_source — whole file into one heap buffer */
+static char *read_source(const char *filename, size_t *len_out){
+    FILE *fp = fopen(filename, "r");
+    char *buf = NULL;
+    size_t len = 0, cap = 0, got;
+
+    if (!fp) return NULL;
+    do {
+        if (len == cap) {
+            char *grown;
+            cap = cap ? cap * 2 : 65536;
+            grown = (char*)as_realloc(buf, cap);
+            if (!grown) { as_free(buf); fclose(fp); return NULL; }
+            buf = grown;
         }
+        got = fread(buf + len, 1, cap - len, fp);
+        len += got;
+    } while (got > 0);
+    fclose(fp);
+    *len_out = len;
+    return buf;
+}
 
-        if (is_directive_tok(tok)) {
-            cursor = lstrip(cursor);
-            cursor += (int)strlen(tok);
-
-            if (strcmp(tok,".data")==0)
-                handle_data(mem,errors,symtab,line_no,has_label?label:NULL,cursor);
-            else if (strcmp(tok,".string")==0)
-                handle_string(mem,errors,symtab,line_no,has_label?label:NULL,cursor);
-            else if (strcmp(tok,".extern")==0) {
-                if (has_label) add_err(errors,line_no,"label before .extern is ignored");
-                handle_extern(symtab,errors,line_no,cursor);
-            } else if (strcmp(tok,".entry")==0) {
-                if (has_label) add_err(errors,line_no,"label before .entry is ignored");
-                handle_entry(symtab,errors,line_no,cursor);
-            } else if (strcmp(tok,".mat")==0) {
-                handle_mat(mem,errors,symtab,line_no,has_label?label:NULL,cursor);
-            }
-        } else {
-            handle_instruction(mem,errors,symtab,line_no,has_label?label:NULL,cursor);
+/* Chunk — a run of whole lines sized on its own, with local IC/DC */
+typedef struct {
+    const char *begin, *end;
+    int first_line;                   /* lines before this chunk */
+    MemoryImage *mem;
+    ErrorList errors;
+    SymSink syms;
+} Chunk;
+
+/* chunk_worker — pthread entry: size one chunk from IC = DC = 0 */
+static void *chunk_worker(void *arg){
+    Chunk *c = (Chunk*)arg;
+    TRACE_BEGIN("first_pass chunk");
+    scan_text(c->begin, c->end, c->first_line, &c->syms, c->mem, &c->errors);
+    TRACE_END("first_pass chunk");
+    return NULL;
+}
+
+/* merge_chunk — append a chunk at the running IC/DC (prefix sum) and replay
+ * its symbol events between its errors, in the order a sequential run has */
+static void merge_chunk(Chunk *c, Symbol **symtab, MemoryImage *mem, ErrorList *errors){
+    int ic_base = mem->IC, dc_base = mem->DC, i;
+    ErrorNode *pending = NULL, *flushed = NULL;
+
+    for (i = 0; i < c->mem->DC; ++i) add_data_word(mem, c->mem->data[i]);
+    if (!move_statements(mem, c->mem, ic_base, dc_base)) add_error(errors,c->first_line + 1,ERR_OUT_OF_MEMORY);
+    mem->IC += c->mem->IC;
+
+    /* chunk errors are newest-first: reverse them into source order */
+    while (c->errors.head) {
+        ErrorNode *e = c->errors.head;
+        c->errors.head = e->next;
+        e->next = pending;
+        pending = e;
+    }
+
+    for (i = 0; i <= c->syms.count; ++i) {
+        const SymEvent *ev = (i < c->syms.count) ? &c->syms.events[i] : NULL;
+        while (pending && (!ev || (ev->after && flushed != ev->after))) {
+            ErrorNode *e = pending;
+            pending = e->next;
+            push_error(errors, e);
+            flushed = e;
         }
+        if (ev) apply_event(symtab, errors, ev, ic_base, dc_base);
     }
+}
 
-    fclose(fp);
-    bump_data_symbols_by_icf(*symtab, mem->IC);
-    return 1;
+/* first_pass_chunked — split at line boundaries, size chunks in parallel,
+ * then assign final addresses by prefix sum over chunk IC/DC */
+static int first_pass_chunked(const char *src, size_t len, int jobs, Symbol **symtab, MemoryImage *mem, ErrorList *errors){
+    Chunk *chunks;
+    pthread_t *tids;
+    int *started;
+    const char *p = src, *end = src + len;
+    int k, line_no = 0, ok = 1;
+
+    chunks = (Chunk*)as_malloc((size_t)jobs * sizeof(Chunk));
+    tids = (pthread_t*)as_malloc((size_t)jobs * sizeof(pthread_t));
+    started = (int*)as_malloc((size_t)jobs * sizeof(int));
+    if (!chunks || !tids || !started) {
+        as_free(chunks); as_free(tids); as_free(started);
+        return 0;
+    }
+
+    for (k = 0; k < jobs; ++k) {
+        Chunk *c = &chunks[k];
+        const char *cut = (k == jobs - 1) ? end : src + (len / (size_t)jobs) * (size_t)(k + 1);
+        c->begin = p;
+        c->first_line = line_no;
+        /* advance whole lines up to the cut, counting them as fgets would */
+        while (p < end && p < cut) { p += next_line_len(p, end); line_no++; }
+        c->end = p;
+        c->mem = (MemoryImage*)as_malloc(sizeof(MemoryImage));
+        if (c->mem) init_memory_image(c->mem);
+        else ok = 0;
+        init_error_list(&c->errors);
+        c->syms.symtab = NULL;
+        c->syms.errors = &c->errors;
+        c->syms.events = NULL;
+        c->syms.count = c->syms.cap = 0;
+        started[k] = 0;
+    }
+
+    for (k = 0; ok && k < jobs; ++k)
+        started[k] = (pthread_create(&tids[k], NULL, chunk_worker, &chunks[k]) == 0);
+
+    for (k = 0; k < jobs; ++k) {
+        Chunk *c = &chunks[k];
+        if (started[k]) pthread_join(tids[k], NULL);
+        else if (ok) chunk_worker(c);   /* no thread: do it here */
+        if (ok) merge_chunk(c, symtab, mem, errors);
+        free_error_list(&c->errors);
+        as_free(c->syms.events);
+        if (c->mem) { free_memory_image(c->mem); as_free(c->mem); }
+    }
+
+    as_free(chunks); as_free(tids); as_free(started);
+    trim_errors(errors);              /* chunks past the limit each kept their own */
+    return ok;
 }
 
+/* first_pass — scan file, fill symtab/DC, and compute IC; 0 if it added errors */
+int first_pass(const char *filename, Symbol **symtab, MemoryImage *mem, ErrorList *errors){
+    size_t len = 0;
+    char *src = read_source(filename, &len);
+    int jobs = g_pass1_jobs, before = errors->count;
+
+    if (!src) { add_error(errors,0,ERR_CANNOT_OPEN,filename); return 0; }
+    TRACE_BEGIN("first_pass");
+
+    if ((size_t)jobs > len / MIN_BYTES_PER_JOB) jobs = (int)(len / MIN_BYTES_PER_JOB);
+    if (jobs < 2 || !first_pass_chunked(src, len, jobs, symtab, mem, errors)) {
+        SymSink syms;
+        syms.symtab = symtab;
+        syms.errors = errors;
+        syms.events = NULL;
+        syms.count = syms.cap = 0;
+        scan_text(src, src + len, 0, &syms, mem, errors);
+    }
+
+    as_free(src);
+    if (pool_strings_enabled() && errors->count == before) (void)pool_strings(mem, *symtab);
+    bump_data_symbols_by_icf(*symtab, mem->IC);
+    TRACE_END("first_pass");
+    return errors->count == before;
+}
@@ -0,0 +1,386 @@
+/* incremental.c
+ * Statement-level reassembly. The expanded source is diffed against the
+ * last good run (common prefix/suffix). If the changed lines on both sides
+ * are plain instructions (no labels, directives or diagnostics), only they
+ * are sized and encoded; later code, labels and fixups shift by the size
+ * delta, references to moved labels are re-patched, and only the .ob lines
+ * that changed are rewritten. Anything else falls back to a full run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "incremental.h"
+#include "assemble.h"
+#include "pre_assembler.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "instruction_encoder.h"
+#include "output_files.h"
+#include "xref.h"
+#include "listing.h"
+#include "error_list.h"
+#include "alloc_stats.h"
+
+#define LOGICAL_BASE 100
+#define LINE_BUF     1024             /* first_pass reads lines in 1023-byte pieces */
+
+/* inc_init — no kept run */
+void inc_init(IncState *st)
+{
+    st->valid = 0;
+    st->lines = NULL;
+    st->line_count = 0;
+    st->symbols = NULL;
+    st->mem = NULL;
+}
+
+/* free_lines — release a line array from load_lines */
+static void free_lines(char **lines, int count)
+{
+    int i;
+    for (i = 0; i < count; ++i) as_free(lines[i]);
+    as_free(lines);
+}
+
+/* inc_free — release the kept run */
+void inc_free(IncState *st)
+{
+    free_lines(st->lines, st->line_count);
+    free_symbol_table(&st->symbols);
+    if (st->mem) { free_memory_image(st->mem); as_free(st->mem); }
+    inc_init(st);
+}
+
+/* load_lines — split a file into lines; 0 if unreadable or a line would be
+ * cut by first_pass's line buffer (line numbers would no longer match) */
+static int load_lines(const char *path, char ***lines_out, int *count_out)
+{
+    FILE *fp = fopen(path, "r");
+    char **lines = NULL;
+    int count = 0, cap = 0;
+    char buf[LINE_BUF];
+
+    if (!fp) return 0;
+    while (fgets(buf, sizeof(buf), fp)) {
+        size_t n = strcspn(buf, "\n");
+        if (buf[n] != '\n' && !feof(fp)) { free_lines(lines, count); fclose(fp); return 0; }
+        if (count == cap) {
+            char **grown;
+            cap = cap ? cap * 2 : 256;
+            grown = (char **)as_realloc(lines, (size_t)cap * sizeof(char *));
+            if (!grown) { free_lines(lines, count); fclose(fp); return 0; }
+            lines = grown;
+        }
+        lines[count] = (char *)as_malloc(n + 1);
+        if (!lines[count]) { free_lines(lines, count); fclose(fp); return 0; }
+        memcpy(lines[count], buf, n);
+        lines[count][n] = '\0';
+        count++;
+    }
+    fclose(fp);
+    *lines_out = lines;
+    *count_out = count;
+    return 1;
+}
+
+/* inc_capture — take ownership of a finished run */
+int inc_capture(IncState *st, const char *am_path, Symbol **symbols, MemoryImage **mem)
+{
+    inc_free(st);
+    if (!load_lines(am_path, &st->lines, &st->line_count)) return 0;
+    st->symbols = *symbols;
+    st->mem = *mem;
+    *symbols = NULL;
+    *mem = NULL;
+    st->valid = 1;
+    return 1;
+}
+
+/* scan_plain — pass 1 over lines [from, to) into scratch; 1 if every line is
+ * a blank/comment or label-less instruction that sizes without diagnostics */
+static int scan_plain(char **lines, int from, int to, MemoryImage *scratch)
+{
+    Symbol *syms = NULL;
+    ErrorList errors;
+    char buf[LINE_BUF];
+    int k, plain;
+
+    init_error_list(&errors);
+    for (k = from; k < to; ++k) {
+        if (strlen(lines[k]) > MAX_LINE_LENGTH) { free_error_list(&errors); return 0; }
+        strcpy(buf, lines[k]);
+        first_pass_line(buf, k + 1, &syms, scratch, &errors);
+    }
+    plain = !errors.head && !syms && scratch->DC == 0;
+    free_error_list(&errors);
+    free_symbol_table(&syms);
+    return plain;
+}
+
+/* first_stmt_after — index of the first statement on a line > line */
+static int first_stmt_after(const MemoryImage *mem, int line)
+{
+    int lo = 0, hi = mem->stmt_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (mem->stmts[mid].line <= line) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/* record_extern_uses — rebuild the .ext list from fixups, as pass 2 does */
+static void record_extern_uses(const IncState *st, Symbol **by_id)
+{
+    int k;
+    of_init();
+    for (k = 0; k < st->mem->fixup_count; ++k) {
+        const Symbol *sym = by_id[st->mem->fix_sym[k]];
+        if (sym->is_extern) of_record_extern_use(sym->name, LOGICAL_BASE + st->mem->fix_slot[k]);
+    }
+}
+
+/* Patch — the edit, worked out before the kept run is touched */
+typedef struct {
+    int p, s;                         /* common prefix / suffix line counts */
+    int a, b;                         /* old statements [a, b) are replaced */
+    int ic0, old_words, new_words;    /* slot range being replaced */
+    int delta, line_shift;
+    MemoryImage *sized;               /* new statements, IC from 0 */
+    Word *code;                       /* their encoded words */
+    CodeSink sink;                    /* their fixups (slots relative to ic0) */
+} Patch;
+
+/* plan_patch — diff, size and encode the changed lines; 0 = needs a full run */
+static int plan_patch(IncState *st, char **lines, int count, Patch *pt)
+{
+    MemoryImage *mem = st->mem;
+    ErrorList errors;
+    int i, limit, ok = 1, old_fixups = 0;
+
+    limit = count < st->line_count ? count : st->line_count;
+    for (pt->p = 0; pt->p < limit && strcmp(lines[pt->p], st->lines[pt->p]) == 0; ++pt->p) {}
+    for (pt->s = 0; pt->s < limit - pt->p &&
+         strcmp(lines[count - 1 - pt->s], st->lines[st->line_count - 1 - pt->s]) == 0; ++pt->s) {}
+
+    /* both sides of the edit must be plain instruction lines */
+    if (!scan_plain(st->lines, pt->p, st->line_count - pt->s, pt->sized)) return 0;
+    free_memory_image(pt->sized);
+    init_memory_image(pt->sized);
+    if (pt->sized->model != mem->model) return 0;
+    if (!scan_plain(lines, pt->p, count - pt->s, pt->sized)) return 0;
+
+    pt->a = first_stmt_after(mem, pt->p);
+    pt->b = first_stmt_after(mem, st->line_count - pt->s);
+    pt->ic0 = pt->a < mem->stmt_count ? mem->stmts[pt->a].ic : mem->IC;
+    pt->old_words = (pt->b < mem->stmt_count ? mem->stmts[pt->b].ic : mem->IC) - pt->ic0;
+    pt->new_words = pt->sized->IC;
+    pt->delta = pt->new_words - pt->old_words;
+    pt->line_shift = count - st->line_count;
+
+    if (mem->IC + pt->delta > MAX_CODE_SIZE) return 0;
+    if (LOGICAL_BASE + mem->IC + pt->delta + mem->DC > mem->model->mem_top) return 0;
+
+    /* encode into a side buffer; slots and fixups are relative to ic0.
+       Slack covers one overlong statement, which then forces a full run. */
+    pt->code = (Word *)as_malloc((size_t)(pt->new_words + 8) * sizeof(Word));
+    if (!pt->code || !alloc_sink_fixups(&pt->sink, 2 * pt->sized->stmt_count)) return 0;
+    memset(pt->code, 0, (size_t)(pt->new_words + 8) * sizeof(Word));
+    pt->sink.code = pt->code;
+    pt->sink.model = mem->model;
+
+    init_error_list(&errors);
+    for (i = 0; ok && i < pt->sized->stmt_count; ++i) {
+        const Statement *sp = &pt->sized->stmts[i];
+        pt->sink.ic = sp->ic;
+        ok = encode_instruction_to(sp->text, st->symbols, &pt->sink, &errors, sp->line) &&
+             pt->sink.ic == sp->ic + sp->words;
+    }
+    ok = ok && !errors.head;          /* includes any label not in the (unchanged) table */
+    free_error_list(&errors);
+    if (!ok) return 0;
+
+    for (i = 0; i < mem->fixup_count; ++i)
+        if (mem->fix_slot[i] >= pt->ic0 && mem->fix_slot[i] < pt->ic0 + pt->old_words)
+            old_fixups++;
+    return mem->fixup_count - old_fixups + pt->sink.fixup_count <= MAX_FIXUPS;
+}
+
+/* splice_statements — replace statements [a, b) by the sized ones */
+static int splice_statements(MemoryImage *mem, Patch *pt)
+{
+    int i, n_new = pt->sized->stmt_count, n_old = pt->b - pt->a;
+    int need = mem->stmt_count - n_old + n_new;
+
+    if (need > mem->stmt_cap) {
+        Statement *grown = (Statement *)as_realloc(mem->stmts, (size_t)need * sizeof(Statement));
+        if (!grown) return 0;
+        mem->stmts = grown;
+        mem->stmt_cap = need;
+    }
+    for (i = pt->a; i < pt->b; ++i) as_free(mem->stmts[i].text);
+    memmove(&mem->stmts[pt->a + n_new], &mem->stmts[pt->b],
+            (size_t)(mem->stmt_count - pt->b) * sizeof(Statement));
+    for (i = 0; i < n_new; ++i) {
+        mem->stmts[pt->a + i] = pt->sized->stmts[i];
+        mem->stmts[pt->a + i].ic += pt->ic0;
+    }
+    pt->sized->stmt_count = 0;        /* texts now belong to mem */
+    mem->stmt_count = need;
+    for (i = pt->a + n_new; i < need; ++i) {
+        mem->stmts[i].ic += pt->delta;
+        mem->stmts[i].line += pt->line_shift;
+    }
+    return 1;
+}
+
+/* apply_patch — commit a planned edit to the kept run and its output files */
+static int apply_patch(IncState *st, const char *src_path, Patch *pt)
+{
+    MemoryImage *mem = st->mem;
+    CodeSink old, merged;
+    Symbol **by_id, *sym;
+    int *dirty;
+    int i, k, nsyms, ndirty = 0, old_end = pt->ic0 + pt->old_words;
+    int entries_moved = 0, externs_changed = 0;
+
+    merged.fix_slot = NULL; merged.fix_sym = NULL; merged.fix_line = NULL;
+    by_id = index_symbols(st->symbols, &nsyms);
+    dirty = (int *)as_malloc((size_t)(mem->fixup_count + pt->new_words + 1) * sizeof(int));
+    if ((!by_id && nsyms > 0) || !dirty || !alloc_sink_fixups(&merged, mem->fixup_count + pt->sink.fixup_count) ||
+        !splice_statements(mem, pt)) {
+        as_free(by_id); as_free(dirty); free_sink_fixups(&merged);
+        return 0;
+    }
+
+    /* code: shift the tail, drop in the new words */
+    memmove(&mem->code[pt->ic0 + pt->new_words], &mem->code[old_end],
+            (size_t)(mem->IC - old_end) * sizeof(Word));
+    memcpy(&mem->code[pt->ic0], pt->code, (size_t)pt->new_words * sizeof(Word));
+    mem->IC += pt->delta;
+    for (i = 0; i < pt->new_words; ++i) dirty[ndirty++] = pt->ic0 + i;
+
+    /* labels at or after the edit (all data labels among them) move by delta */
+    if (pt->delta != 0)
+        for (sym = st->symbols; sym; sym = sym->next)
+            if (!sym->is_extern && sym->address >= LOGICAL_BASE + pt->ic0) {
+                sym->address += pt->delta;
+                if (sym->is_entry) entries_moved = 1;
+            }
+    /* and every definition (and data line) below the edited lines moves by line_shift */
+    if (pt->line_shift != 0) {
+        for (sym = st->symbols; sym; sym = sym->next)
+            if (sym->line > pt->p) sym->line += pt->line_shift;
+        for (i = 0; i < mem->span_count; ++i)
+            if (mem->spans[i].line > pt->p) mem->spans[i].line += pt->line_shift;
+    }
+
+    /* fixups in slot order: before, new, shifted tail */
+    sink_from_image(&old, mem);
+    for (k = 0; k < mem->fixup_count && mem->fix_slot[k] < pt->ic0; ++k) copy_fixup(&merged, &old, k, 0, 0);
+    for (; k < mem->fixup_count && mem->fix_slot[k] < old_end; ++k)
+        if (by_id[mem->fix_sym[k]]->is_extern) externs_changed = 1;
+    for (i = 0; i < pt->sink.fixup_count; ++i) copy_fixup(&merged, &pt->sink, i, pt->ic0, 0);
+    for (; k < mem->fixup_count; ++k) copy_fixup(&merged, &old, k, pt->delta, pt->line_shift);
+    memcpy(mem->fix_slot, merged.fix_slot, (size_t)merged.fixup_count * sizeof(unsigned short));
+    memcpy(mem->fix_sym, merged.fix_sym, (size_t)merged.fixup_count * sizeof(int));
+    memcpy(mem->fix_line, merged.fix_line, (size_t)merged.fixup_count * sizeof(int));
+    mem->fixup_count = merged.fixup_count;
+    free_sink_fixups(&merged);
+
+    /* patch the new words, and any older word whose target moved */
+    for (k = 0; k < mem->fixup_count; ++k) {
+        int slot = mem->fix_slot[k];
+        int in_new = slot >= pt->ic0 && slot < pt->ic0 + pt->new_words;
+        int word;
+        if (!in_new && pt->delta == 0) continue;
+        sym = by_id[mem->fix_sym[k]];
+        if (sym->is_extern && (in_new || slot >= pt->ic0)) externs_changed = 1;
+        word = fixup_word(mem->model, sym);
+        if (word != mem->code[slot] && slot < pt->ic0) dirty[ndirty++] = slot;
+        mem->code[slot] = (Word)word;
+    }
+
+    /* outputs: .ob in place (tail rewritten when addresses shifted) */
+    as_set_phase(PHASE_OUTPUT);
+    if (!update_object_file(src_path, mem, pt->delta != 0, dirty, ndirty, pt->delta != 0 ? pt->ic0 : -1)) {
+        record_extern_uses(st, by_id);
+        write_output_files(src_path, mem, st->symbols);
+    } else {
+        if (entries_moved) write_entry_file(src_path, mem, st->symbols);
+        if (externs_changed) {
+            record_extern_uses(st, by_id);
+            write_extern_file(src_path, mem);
+        }
+    }
+    if (output_extras() & OUT_XREF) write_xref_file(src_path, mem, st->symbols);
+    as_free(by_id);
+    as_free(dirty);
+    return 1;
+}
+
+/* try_incremental — 1 if the edit was applied in place; 0 = run in full */
+static int try_incremental(const char *src_path, IncState *st)
+{
+    char expanded_am[512] = {0};
+    ErrorList errors;
+    char **lines = NULL;
+    int count = 0, done = 0;
+    Patch pt;
+
+    memset(&pt, 0, sizeof(pt));
+    init_error_list(&errors);
+
+    as_set_phase(PHASE_PRE);
+    if (!pre_assemble(src_path, expanded_am, sizeof(expanded_am), &errors) || errors.head ||
+        !load_lines(expanded_am[0] ? expanded_am : src_path, &lines, &count))
+        goto out;
+
+    as_set_phase(PHASE_PASS1);
+    pt.sized = (MemoryImage *)as_malloc(sizeof(MemoryImage));
+    if (!pt.sized) goto out;
+    init_memory_image(pt.sized);
+
+    if (plan_patch(st, lines, count, &pt)) {
+        as_set_phase(PHASE_PASS2);
+        if (apply_patch(st, src_path, &pt)) {
+            write_dependencies(src_path);
+            if (output_extras() & OUT_LST) write_listing_file(src_path, expanded_am, st->mem);
+            free_lines(st->lines, st->line_count);
+            st->lines = lines;
+            st->line_count = count;
+            lines = NULL;
+            done = 1;
+        }
+    }
+
+out:
+    if (lines) free_lines(lines, count);
+    free_error_list(&errors);
+    if (expanded_am[0]) remove(expanded_am);
+    if (pt.sized) { free_memory_image(pt.sized); as_free(pt.sized); }
+    as_free(pt.code);
+    free_sink_fixups(&pt.sink);
+    return done;
+}
+
+/* reassemble — patch the kept run when possible, otherwise assemble in full */
+int reassemble(const char *arg, int mem_stats, IncState *st)
+{
+    char src_path[512];
+    int done;
+
+    if (!st->valid) {
+        inc_free(st);
+        return assemble_source(arg, mem_stats, st);
+    }
+
+    derive_source_name(arg, src_path, sizeof(src_path));
+    as_reset_stats();
+    done = try_incremental(src_path, st);
+    if (mem_stats) as_report(stderr, src_path);
+    if (done) return 1;
+
+    inc_free(st);
+    return assemble_source(arg, mem_stats, st);
+}
@@ -6,7 +6,6 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
-#include <stdarg.h>
 
 #include "instruction_encoder.h"
 #include "instruction_set.h"
@@ -14,6 +13,7 @@
 #include "error_list.h"
 #include "memory_image.h"
 #include "addressing_modes.h"
+#include "alloc_stats.h"
 
 /* Fallback if not coming from a shared header */
 #ifndef MAX_LINE_LENGTH
@@ -27,21 +27,13 @@
    [9..6] opcode
    [5..4] src addressing (2 bits)
    [3..2] dst addressing (2 bits)
-   [1..0] ARE (A=00, E=01, R=10) */
+   [1..0] ARE (A=00, E=01, R=10)
+   Extension words carry a value in [addr_bits+1..2]; the width comes
+   from the image's MemoryModel (8 bits in the classic model). */
 enum { ARE_A = 0, ARE_E = 1, ARE_R = 2 };
 
 /* ---------- small helpers (ANSI C) ---------- */
 
-/* add_err — printf-style add_error */
-static void add_err(ErrorList *errors, int line, const char *fmt, ...) {
-    char buf[ERROR_MSG_LEN];
-    va_list ap;
-    va_start(ap, fmt);
-    vsprintf(buf, fmt, ap);
-    va_end(ap);
-    add_error(errors, line, buf);
-}
-
 /* strip_comment — cut ';' to end */
 static void strip_comment(char *s) {
     for (; *s; ++s) if (*s == ';') { *s = '\0'; break; }
@@ -84,7 +76,7 @@ static int is_directive(const char *tok) {
 /* xstrdup — ANSI-safe strdup */
 static char *xstrdup(const char *s) {
     size_t n = strlen(s) + 1;
-    char *p = (char*)malloc(n);
+    char *p = (char*)as_malloc(n);
     if (p) memcpy(p, s, n);
     return p;
 }
@@ -185,40 +177,63 @@ static int detect_mode_lenient(const char *operand) {
 static int pack_base_word(int opcode,int src_mode,int dst_mode){
     return ((opcode & 0xF)<<6) | ((src_mode & 0x3)<<4) | ((dst_mode & 0x3)<<2) | ARE_A;
 }
-static int pack_value_word(int value,int are){ return ((value & 0xFF)<<2) | (are & 0x3); }
+static int pack_value_word(const MemoryModel *mm,int value,int are){
+    return ((value & ((1 << mm->addr_bits) - 1))<<2) | (are & 0x3);
+}
+
+/* emit_label_ref — placeholder word plus a fixup on the label's symbol id */
+static void emit_label_ref(const char *label, Symbol *symbols, CodeSink *out, ErrorList *errors, int line_num) {
+    const Symbol *sym = find_symbol(symbols, label);
+    int word_index = out->ic;         /* record the slot to patch */
+
+    sink_emit(out, 0);
+    if (!sym) add_error(errors, line_num, ERR_UNDEFINED_LABEL, label);
+    else sink_fixup(out, word_index, sym->id, line_num);
+}
 
 /* emit_matrix_words — label fixup + packed regs */
-static void emit_matrix_words(const char *operand, MemoryImage *mem, ErrorList *errors, int line_num) {
+static void emit_matrix_words(const char *operand, Symbol *symbols, CodeSink *out, ErrorList *errors, int line_num) {
     char label[MAX_LABEL_LEN];
     int rr, cc;
 
     if (!enc_is_matrix(operand, label, &rr, &cc)) {
-        add_err(errors, line_num, "invalid matrix operand '%s'", operand);
+        add_error(errors, line_num, ERR_MATRIX_OPERAND, operand);
         return;
     }
 
     /* word 1: address of label (to be fixed up with E/R) */
-    {
-        int word_index = mem->IC;   /* record the slot to patch */
-        add_code_word(mem, 0);
-        add_fixup(mem, word_index, label, line_num);
-    }
+    emit_label_ref(label, symbols, out, errors, line_num);
 
     /* word 2: packed regs (row in bits 6..9, col in 2..5) + ARE=A */
     {
         int w = ((rr & 0x7) << 6) | ((cc & 0x7) << 2) | ARE_A;
-        add_code_word(mem, w);
+        sink_emit(out, w);
     }
 }
 
 /* ---------- main API ---------- */
 
-/* encode_instruction — parse/encode a single line into MemoryImage */
+/* encode_instruction — parse/encode a single line, appending to MemoryImage */
 int encode_instruction(const char *line,
                        Symbol *symbols,
                        MemoryImage *mem,
                        ErrorList *errors,
                        int line_num)
+{
+    CodeSink out;
+    int rc;
+    sink_from_image(&out, mem);
+    rc = encode_instruction_to(line, symbols, &out, errors, line_num);
+    sink_to_image(&out, mem);
+    return rc;
+}
+
+/* encode_instruction_to — parse/encode a single line into a CodeSink */
+int encode_instruction_to(const char *line,
+                          Symbol *symbols,
+                          CodeSink *out,
+                          ErrorList *errors,
+                          int line_num)
 {
     char temp[MAX_LINE_LENGTH+4];
     char tokens[6][31];
@@ -229,7 +244,6 @@ int encode_instruction(const char *line,
     int operand_count;
     int start_index;
 
-    (void)symbols;
 
     /* prep line */
     strncpy(temp, line, sizeof(temp)-1);
@@ -255,7 +269,7 @@ int encode_instruction(const char *line,
     start_index = 0;
     if (strchr(tokens[0], ':') != NULL) {
         if (token_count < 2) {
-            add_err(errors, line_num, "Label without instruction");
+            add_error(errors, line_num, ERR_LABEL_NO_STATEMENT);
             return 0;
         }
         start_index = 1;
@@ -281,7 +295,7 @@ int encode_instruction(const char *line,
         after = lstrip(after);
 
         opsbuf = xstrdup(after ? after : "");
-        if (!opsbuf) { add_err(errors, line_num, "out of memory"); return 0; }
+        if (!opsbuf) { add_error(errors, line_num, ERR_OUT_OF_MEMORY); return 0; }
 
         nops = split_commas_inplace(opsbuf, ops, 2);
         for (i = 0; i < nops; i++) trim_inplace(ops[i]);
@@ -293,56 +307,51 @@ int encode_instruction(const char *line,
 
         /* validate operand count */
         if (instr->operands != operand_count) {
-            char msg[96];
-            sprintf(msg, "Operand count mismatch for %s (expected %d, got %d)",
-                    instr->name, instr->operands, operand_count);
-            add_err(errors, line_num, msg);
-            free(opsbuf);
+            add_error(errors, line_num, ERR_OPERAND_COUNT, instr->name, instr->operands, operand_count);
+            as_free(opsbuf);
             return 0;
         }
 
         /* 0 operands */
         if (operand_count == 0) {
             int base = pack_base_word(instr->opcode, 0, 0);
-            add_code_word(mem, base);
-            free(opsbuf);
+            sink_emit(out, base);
+            as_free(opsbuf);
             return 1;
         }
 
         /* 1 operand (destination) */
         if (operand_count == 1) {
             int base;
-            int dst_r, word_index;
+            int dst_r;
             long val;
             int dst_mode;
 
             op1s = ops[0];
             dst_mode = detect_mode_lenient(op1s);
             if (dst_mode < 0 || dst_mode > 3 || !instr->allowed_dst[dst_mode]) {
-                add_err(errors, line_num, "Invalid addressing mode for operand");
-                free(opsbuf);
+                add_error(errors, line_num, ERR_ADDRESSING_MODE, 0, instr->name);
+                as_free(opsbuf);
                 return 0;
             }
 
             base = pack_base_word(instr->opcode, 0, dst_mode);
-            add_code_word(mem, base);
+            sink_emit(out, base);
 
             if (dst_mode == ADDR_REGISTER) {
                 dst_r = op1s[1] - '0';
                 /* DEST register in bits 2..5 */
-                add_code_word(mem, ((dst_r & 0x7) << 2) | ARE_A);
+                sink_emit(out, ((dst_r & 0x7) << 2) | ARE_A);
             } else if (dst_mode == ADDR_IMMEDIATE) {
                 val = strtol(op1s + 1, NULL, 10);
-                add_code_word(mem, pack_value_word((int)val, ARE_A));
+                sink_emit(out, pack_value_word(out->model, (int)val, ARE_A));
             } else if (dst_mode == ADDR_DIRECT) {
-                word_index = mem->IC;
-                add_code_word(mem, 0);
-                add_fixup(mem, word_index, op1s, line_num);
+                emit_label_ref(op1s, symbols, out, errors, line_num);
             } else { /* ADDR_MATRIX */
-                emit_matrix_words(op1s, mem, errors, line_num);
+                emit_matrix_words(op1s, symbols, out, errors, line_num);
             }
 
-            free(opsbuf);
+            as_free(opsbuf);
             return 1;
         }
 
@@ -354,24 +363,24 @@ int encode_instruction(const char *line,
         dst_mode = detect_mode_lenient(op1s);
 
         if (src_mode < 0 || src_mode > 3 || !instr->allowed_src[src_mode]) {
-            add_err(errors, line_num, "Invalid addressing mode for source operand");
-            free(opsbuf);
+            add_error(errors, line_num, ERR_ADDRESSING_MODE, 0, instr->name);
+            as_free(opsbuf);
             return 0;
         }
         if (dst_mode < 0 || dst_mode > 3 || !instr->allowed_dst[dst_mode]) {
-            add_err(errors, line_num, "Invalid addressing mode for destination operand");
-            free(opsbuf);
+            add_error(errors, line_num, ERR_ADDRESSING_MODE, 1, instr->name);
+            as_free(opsbuf);
             return 0;
         }
 
-        add_code_word(mem, pack_base_word(instr->opcode, src_mode, dst_mode));
+        sink_emit(out, pack_base_word(instr->opcode, src_mode, dst_mode));
 
         /* reg-reg packs into one word: SRC→bits 6–9, DST→bits 2–5 */
         if (src_mode == ADDR_REGISTER && dst_mode == ADDR_REGISTER) {
             int sr = op0s[1] - '0';
             int dr = op1s[1] - '0';
-            add_code_word(mem, ((sr & 0x7) << 6) | ((dr & 0x7) << 2) | ARE_A);
-            free(opsbuf);
+            sink_emit(out, ((sr & 0x7) << 6) | ((dr & 0x7) << 2) | ARE_A);
+            as_free(opsbuf);
             return 1;
         }
 
@@ -379,35 +388,31 @@ int encode_instruction(const char *line,
         if (src_mode == ADDR_REGISTER) {
             int r = op0s[1] - '0';
             /* SRC register in bits 6..9 */
-            add_code_word(mem, ((r & 0x7) << 6) | ARE_A);
+            sink_emit(out, ((r & 0x7) << 6) | ARE_A);
         } else if (src_mode == ADDR_IMMEDIATE) {
             long v = strtol(op0s + 1, NULL, 10);
-            add_code_word(mem, pack_value_word((int)v, ARE_A));
+            sink_emit(out, pack_value_word(out->model, (int)v, ARE_A));
         } else if (src_mode == ADDR_DIRECT) {
-            int word_index = mem->IC;
-            add_code_word(mem, 0);
-            add_fixup(mem, word_index, op0s, line_num);
+            emit_label_ref(op0s, symbols, out, errors, line_num);
         } else { /* ADDR_MATRIX */
-            emit_matrix_words(op0s, mem, errors, line_num);
+            emit_matrix_words(op0s, symbols, out, errors, line_num);
         }
 
         /* destination extra word(s) */
         if (dst_mode == ADDR_REGISTER) {
             int r = op1s[1] - '0';
             /* DEST register in bits 2..5 */
-            add_code_word(mem, ((r & 0x7) << 2) | ARE_A);
+            sink_emit(out, ((r & 0x7) << 2) | ARE_A);
         } else if (dst_mode == ADDR_IMMEDIATE) {
             long v = strtol(op1s + 1, NULL, 10);
-            add_code_word(mem, pack_value_word((int)v, ARE_A));
+            sink_emit(out, pack_value_word(out->model, (int)v, ARE_A));
         } else if (dst_mode == ADDR_DIRECT) {
-            int word_index = mem->IC;
-            add_code_word(mem, 0);
-            add_fixup(mem, word_index, op1s, line_num);
+            emit_label_ref(op1s, symbols, out, errors, line_num);
         } else { /* ADDR_MATRIX */
-            emit_matrix_words(op1s, mem, errors, line_num);
+            emit_matrix_words(op1s, symbols, out, errors, line_num);
         }
 
-        free(opsbuf);
+        as_free(opsbuf);
         return 1;
     }
 }
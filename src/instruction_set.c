@@ -47,6 +47,12 @@ const Instruction* find_instruction(const char *name) {
     return NULL;
 }
 
+/* instruction_by_opcode — the table is indexed by opcode */
+const Instruction* instruction_by_opcode(int opcode) {
+    if (opcode < 0 || opcode >= NUM_OPCODES) return NULL;
+    return &instructions[opcode];
+}
+
 /* print_instruction_table — debug print of instruction set */
 void print_instruction_table(void) {
     int i;
@@ -0,0 +1,294 @@
+/* linker.c
+ * Standalone linker: combines assembled modules (.ob/.ent/.ext) into one image.
+ * Exports from .ent feed a hashed global table; code/data are relocated and
+ * E-marked extern words are patched. Each input file is read exactly once,
+ * through the shared object reader.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_image.h"
+#include "symbol_table.h"
+#include "output_files.h"
+#include "alloc_stats.h"
+#include "object_reader.h"
+
+#define LOGICAL_BASE 100
+
+enum { ARE_A = 0, ARE_E = 1, ARE_R = 2 };
+
+/* ---- module records ----------------------------------------------------- */
+
+/* Module — one assembled input, kept in memory until output: only its
+ * words and refs, not the fixed-size image it was read into */
+typedef struct {
+    char *base;                       /* path without extension */
+    int   code_size, data_size;
+    Word *code, *data;                /* code_size / data_size words */
+    ObjRef *ents;  int ent_count;     /* .ent lines */
+    ObjRef *exts;  int ext_count;     /* .ext lines, one per extern use */
+    int   code_off, data_off;         /* placement in the linked image */
+} Module;
+
+/* GlobalSym — hashed export: name → final address */
+typedef struct GlobalSym {
+    const char *name;                 /* points into the owning Module */
+    int module;
+    int address;                      /* relocated absolute address */
+    struct GlobalSym *next;
+} GlobalSym;
+
+typedef struct {
+    GlobalSym **buckets;
+    unsigned    mask;                 /* bucket count - 1 (power of two) */
+    int         count;
+} GlobalTable;
+
+static const MemoryModel *g_model;
+
+/* ---- small helpers ------------------------------------------------------ */
+
+/* xmalloc_or_die — allocation that aborts the link on failure */
+static void *xmalloc_or_die(size_t n)
+{
+    void *p = as_malloc(n ? n : 1);
+    if (!p) { fprintf(stderr, "[error] linker: out of memory\n"); exit(1); }
+    return p;
+}
+
+/* hash_name — FNV-1a over the symbol name */
+static unsigned hash_name(const char *s)
+{
+    unsigned h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+/* ---- global symbol table ------------------------------------------------ */
+
+/* gt_init — empty table with room for about n exports */
+static void gt_init(GlobalTable *t, int n)
+{
+    unsigned size = 64;
+    while ((int)size < n * 2) size <<= 1;
+    t->buckets = (GlobalSym**)xmalloc_or_die(size * sizeof(GlobalSym*));
+    memset(t->buckets, 0, size * sizeof(GlobalSym*));
+    t->mask = size - 1;
+    t->count = 0;
+}
+
+/* gt_find — lookup export by name */
+static GlobalSym *gt_find(const GlobalTable *t, const char *name)
+{
+    GlobalSym *g = t->buckets[hash_name(name) & t->mask];
+    for (; g; g = g->next) if (strcmp(g->name, name) == 0) return g;
+    return NULL;
+}
+
+/* gt_free — release all entries and buckets */
+static void gt_free(GlobalTable *t)
+{
+    unsigned i;
+    for (i = 0; i <= t->mask; ++i) {
+        GlobalSym *g = t->buckets[i];
+        while (g) { GlobalSym *n = g->next; as_free(g); g = n; }
+    }
+    as_free(t->buckets);
+}
+
+/* ---- loading ------------------------------------------------------------ */
+
+/* load_module — read <base>.ob (+ optional .ent/.ext) through the scratch
+ * object, keeping only the used words and the ref tables in m */
+static int load_module(const char *arg, Module *m, ObjectFile *scratch)
+{
+    const char *dot = strrchr(arg, '.'), *slash = strrchr(arg, '/');
+    size_t blen = (dot && (!slash || dot > slash)) ? (size_t)(dot - arg) : strlen(arg);
+
+    memset(m, 0, sizeof(*m));
+    if (blen >= 512) { fprintf(stderr, "[error] %s: path too long\n", arg); return 0; }
+    m->base = (char*)xmalloc_or_die(blen + 1);
+    memcpy(m->base, arg, blen); m->base[blen] = '\0';
+
+    if (!read_object_file(m->base, g_model, scratch)) {
+        free_object_file(scratch);
+        as_free(m->base);
+        return 0;
+    }
+    m->code_size = scratch->mem.IC;
+    m->data_size = scratch->mem.DC;
+    m->code = (Word*)xmalloc_or_die((size_t)m->code_size * sizeof(Word));
+    m->data = (Word*)xmalloc_or_die((size_t)m->data_size * sizeof(Word));
+    memcpy(m->code, scratch->mem.code, (size_t)m->code_size * sizeof(Word));
+    memcpy(m->data, scratch->mem.data, (size_t)m->data_size * sizeof(Word));
+
+    /* the ref tables move to the module */
+    m->ents = scratch->ents; m->ent_count = scratch->ent_count;
+    m->exts = scratch->exts; m->ext_count = scratch->ext_count;
+    scratch->ents = scratch->exts = NULL;
+    free_object_file(scratch);
+    return 1;
+}
+
+/* free_module — release what load_module kept */
+static void free_module(Module *m)
+{
+    as_free(m->code); as_free(m->data);
+    as_free(m->ents); as_free(m->exts);
+    as_free(m->base);
+}
+
+/* ---- relocation --------------------------------------------------------- */
+
+/* relocate — module-local address → address in the linked image */
+static int relocate(const Module *m, int local, int total_code)
+{
+    if (local < LOGICAL_BASE + m->code_size)
+        return LOGICAL_BASE + m->code_off + (local - LOGICAL_BASE);
+    return LOGICAL_BASE + total_code + m->data_off + (local - LOGICAL_BASE - m->code_size);
+}
+
+/* value_word — pack an address into an extension word */
+static int value_word(int address, int are)
+{
+    return ((address & ((1 << g_model->addr_bits) - 1)) << 2) | are;
+}
+
+/* ---- entry point -------------------------------------------------------- */
+
+/* main — linker [--model M] [-o out] module... */
+int main(int argc, char **argv)
+{
+    const char *out_name = "linked";
+    Module *mods;
+    int nmods = 0, i, j, ok = 1;
+    int total_code = 0, total_data = 0, total_ents = 0;
+    GlobalTable table;
+    MemoryImage *mem;
+    ObjectFile *scratch;
+    Symbol *exports = NULL, *tail = NULL;
+
+    g_model = default_memory_model();
+    mods = (Module*)xmalloc_or_die((size_t)argc * sizeof(Module));
+    scratch = (ObjectFile*)xmalloc_or_die(sizeof(ObjectFile));
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            g_model = find_memory_model(argv[++i]);
+            if (!g_model) { fprintf(stderr, "[error] --model expects 'classic' or 'wide'\n"); return 1; }
+            continue;
+        }
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) { out_name = argv[++i]; continue; }
+        if (!load_module(argv[i], &mods[nmods], scratch)) { ok = 0; continue; }
+        mods[nmods].code_off = total_code;
+        mods[nmods].data_off = total_data;
+        total_code += mods[nmods].code_size;
+        total_data += mods[nmods].data_size;
+        total_ents += mods[nmods].ent_count;
+        nmods++;
+    }
+    as_free(scratch);
+    if (nmods == 0) {
+        printf("usage: %s [--model classic|wide] [-o out] <module> [module ...]\n", argv[0]);
+        return ok ? 0 : 1;
+    }
+    if (!ok) return 1;
+
+    if (total_code > MAX_CODE_SIZE || total_data > MAX_DATA_SIZE ||
+        LOGICAL_BASE + total_code + total_data > g_model->mem_top) {
+        fprintf(stderr, "[error] linked image (%d code + %d data words) exceeds the memory model\n",
+                total_code, total_data);
+        return 1;
+    }
+
+    /* global table of exports, with final addresses */
+    gt_init(&table, total_ents);
+    for (i = 0; i < nmods; ++i) {
+        for (j = 0; j < mods[i].ent_count; ++j) {
+            const ObjRef *r = &mods[i].ents[j];
+            unsigned b = hash_name(r->name) & table.mask;
+            GlobalSym *g = gt_find(&table, r->name);
+            if (g) {
+                fprintf(stderr, "[error] symbol '%s' exported by both %s and %s\n",
+                        r->name, mods[g->module].base, mods[i].base);
+                ok = 0;
+                continue;
+            }
+            g = (GlobalSym*)xmalloc_or_die(sizeof(GlobalSym));
+            g->name = r->name;
+            g->module = i;
+            g->address = relocate(&mods[i], r->address, total_code);
+            g->next = table.buckets[b];
+            table.buckets[b] = g;
+            table.count++;
+        }
+    }
+
+    /* relocate R words, then patch E words from each module's .ext */
+    for (i = 0; i < nmods; ++i) {
+        Module *m = &mods[i];
+        Word *code = m->code;
+        for (j = 0; j < m->code_size; ++j) {
+            int w = code[j];
+            if ((w & 0x3) == ARE_R)
+                code[j] = (Word)value_word(relocate(m, w >> 2, total_code), ARE_R);
+        }
+        for (j = 0; j < m->ext_count; ++j) {
+            const ObjRef *r = &m->exts[j];
+            int idx = r->address - LOGICAL_BASE;
+            GlobalSym *g = gt_find(&table, r->name);
+            if (idx < 0 || idx >= m->code_size || (code[idx] & 0x3) != ARE_E) {
+                fprintf(stderr, "[error] %s.ext: '%s' use site is not an external word\n",
+                        m->base, r->name);
+                ok = 0;
+            } else if (!g) {
+                fprintf(stderr, "[error] %s: undefined external '%s'\n", m->base, r->name);
+                ok = 0;
+            } else {
+                code[idx] = (Word)value_word(g->address, ARE_R);
+            }
+        }
+    }
+
+    if (ok) {
+        /* lay out linked image: all code first, then all data */
+        set_memory_model(g_model);
+        mem = (MemoryImage*)xmalloc_or_die(sizeof(MemoryImage));
+        init_memory_image(mem);
+        for (i = 0; i < nmods; ++i)
+            for (j = 0; j < mods[i].code_size; ++j) add_code_word(mem, mods[i].code[j]);
+        for (i = 0; i < nmods; ++i)
+            for (j = 0; j < mods[i].data_size; ++j) add_data_word(mem, mods[i].data[j]);
+
+        /* re-export every entry at its linked address, in module order */
+        for (i = 0; i < nmods; ++i) {
+            for (j = 0; j < mods[i].ent_count; ++j) {
+                const ObjRef *r = &mods[i].ents[j];
+                Symbol *s = (Symbol*)xmalloc_or_die(sizeof(Symbol));
+                strcpy(s->name, r->name);
+                s->address = relocate(&mods[i], r->address, total_code);
+                s->type = SYMBOL_CODE;
+                s->is_entry = 1;
+                s->is_extern = 0;
+                s->line = 0;
+                s->id = tail ? tail->id + 1 : 0;
+                s->next = NULL;
+                if (tail) tail->next = s; else exports = s;
+                tail = s;
+            }
+        }
+
+        of_init();
+        write_output_files(out_name, mem, exports);
+        free_symbol_table(&exports);
+        free_memory_image(mem);
+        as_free(mem);
+    }
+
+    gt_free(&table);
+    for (i = 0; i < nmods; ++i) free_module(&mods[i]);
+    as_free(mods);
+    return ok ? 0 : 1;
+}
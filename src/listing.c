@@ -0,0 +1,71 @@
+/* listing.c
+ * Writes the .lst in one streaming pass: the .am is copied line by line
+ * while two cursors walk the statement and data-span maps (both in line
+ * order) to find each line's words in the image. Nothing is re-encoded.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "listing.h"
+#include "output_files.h"
+
+#define LOGICAL_BASE 100
+#define LST_LINE_LEN 1024             /* same segments as pass 1's line reader */
+
+/* put_words — one row per word; the first row carries the line and its text */
+static void put_words(FILE *fp, const MemoryModel *mm, int line_no, const char *text,
+                      const Word *words, int count, int addr)
+{
+    char a4[16], w4[16];
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        to_base4_letters((unsigned)(addr + i), mm->addr_digits, a4);
+        to_base4_letters((unsigned)words[i], mm->word_digits, w4);
+        if (i == 0) fprintf(fp, "%6d %6d  %s  %s  %s\n", line_no, addr, a4, w4, text);
+        else fprintf(fp, "%6s %6d  %s  %s\n", "", addr + i, a4, w4);
+    }
+}
+
+/* write_listing_file — merge the .am lines with the line maps */
+void write_listing_file(const char *src_filename, const char *am_path, const MemoryImage *mem)
+{
+    const MemoryModel *mm;
+    char path[300], line[LST_LINE_LEN];
+    FILE *in, *out;
+    int line_no = 0, s = 0, d = 0, pad;
+
+    if (!src_filename || !am_path || !mem) return;
+    mm = mem->model ? mem->model : default_memory_model();
+    in = fopen(am_path, "r");
+    if (!in) return;
+    output_path(src_filename, ".lst", path);
+    out = fopen(path, "w");
+    if (!out) { fclose(in); return; }
+
+    pad = 6 + 1 + 6 + 2 + mm->addr_digits + 2 + mm->word_digits + 2;
+    fprintf(out, "%6s %6s  %-*s  %-*s  %s\n", "; line", "addr", mm->addr_digits, "b4",
+            mm->word_digits, "word", "source");
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        ++line_no;
+        while (s < mem->stmt_count && mem->stmts[s].line < line_no) ++s;
+        while (d < mem->span_count && mem->spans[d].line < line_no) ++d;
+
+        if (s < mem->stmt_count && mem->stmts[s].line == line_no && mem->stmts[s].words > 0) {
+            const Statement *st = &mem->stmts[s];
+            put_words(out, mm, line_no, line, &mem->code[st->ic], st->words, LOGICAL_BASE + st->ic);
+        } else if (d < mem->span_count && mem->spans[d].line == line_no) {
+            const DataSpan *sp = &mem->spans[d];
+            put_words(out, mm, line_no, line, &mem->data[sp->dc], sp->words,
+                      LOGICAL_BASE + mem->IC + sp->dc);
+        } else if (line[0]) {
+            fprintf(out, "%6d %*s%s\n", line_no, pad - 7, "", line);
+        } else {
+            fprintf(out, "%6d\n", line_no);
+        }
+    }
+    fclose(in);
+    fclose(out);
+}
@@ -5,6 +5,37 @@
 
 #include <string.h>
 #include "memory_image.h"
+#include "alloc_stats.h"
+
+/* name, word bits, address bits, address letters, word letters, top */
+static const MemoryModel g_models[] = {
+    { "classic", 10,  8, 4, 5,  256 },
+    { "wide",    14, 12, 6, 7, 4096 }
+};
+
+#define NUM_MODELS ((int)(sizeof(g_models) / sizeof(g_models[0])))
+
+static const MemoryModel *g_current_model = &g_models[0];
+
+/* default_memory_model — the classic 10-bit / 256-word machine */
+const MemoryModel *default_memory_model(void) {
+    return &g_models[0];
+}
+
+/* find_memory_model — lookup model by name */
+const MemoryModel *find_memory_model(const char *name) {
+    int i;
+    if (!name) return NULL;
+    for (i = 0; i < NUM_MODELS; ++i) {
+        if (strcmp(g_models[i].name, name) == 0) return &g_models[i];
+    }
+    return NULL;
+}
+
+/* set_memory_model — select model for images initialized from now on */
+void set_memory_model(const MemoryModel *model) {
+    g_current_model = model ? model : default_memory_model();
+}
 
 /* init_memory_image — reset all fields and clear buffers */
 void init_memory_image(MemoryImage *m) {
@@ -15,33 +46,194 @@ void init_memory_image(MemoryImage *m) {
     m->IC = 0;
     m->DC = 0;
     m->fixup_count = 0;
+    m->model = g_current_model;
+    m->stmts = NULL;
+    m->stmt_count = 0;
+    m->stmt_cap = 0;
+    m->spans = NULL;
+    m->span_count = 0;
+    m->span_cap = 0;
+}
+
+/* free_memory_image — free statement texts and lists */
+void free_memory_image(MemoryImage *m) {
+    int i;
+    if (!m) return;
+    for (i = 0; i < m->stmt_count; ++i) as_free(m->stmts[i].text);
+    as_free(m->stmts);
+    m->stmts = NULL;
+    m->stmt_count = m->stmt_cap = 0;
+    as_free(m->spans);
+    m->spans = NULL;
+    m->span_count = m->span_cap = 0;
+}
+
+/* add_statement — append one sized instruction statement */
+int add_statement(MemoryImage *m, int line, int ic, int words, const char *text) {
+    Statement *st;
+    size_t n;
+    if (!m || !text) return 0;
+    if (m->stmt_count == m->stmt_cap) {
+        int newcap = m->stmt_cap ? m->stmt_cap * 2 : 64;
+        Statement *grown = (Statement *)as_realloc(m->stmts, (size_t)newcap * sizeof(Statement));
+        if (!grown) return 0;
+        m->stmts = grown;
+        m->stmt_cap = newcap;
+    }
+    n = strlen(text) + 1;
+    st = &m->stmts[m->stmt_count];
+    st->text = (char *)as_malloc(n);
+    if (!st->text) return 0;
+    memcpy(st->text, text, n);
+    st->line = line;
+    st->ic = ic;
+    st->words = words;
+    m->stmt_count++;
+    return 1;
+}
+
+/* add_data_span — append one data directive's (line, DC, words) */
+int add_data_span(MemoryImage *m, int line, int dc, int words, int string) {
+    DataSpan *sp;
+    if (!m) return 0;
+    if (m->span_count == m->span_cap) {
+        int newcap = m->span_cap ? m->span_cap * 2 : 64;
+        DataSpan *grown = (DataSpan *)as_realloc(m->spans, (size_t)newcap * sizeof(DataSpan));
+        if (!grown) return 0;
+        m->spans = grown;
+        m->span_cap = newcap;
+    }
+    sp = &m->spans[m->span_count++];
+    sp->line = line;
+    sp->dc = dc;
+    sp->words = words;
+    sp->string = string;
+    return 1;
+}
+
+/* move_statements — hand src's statements (and their texts) and data spans over to dst */
+int move_statements(MemoryImage *dst, MemoryImage *src, int ic_base, int dc_base) {
+    int i, need;
+    if (!dst || !src) return 0;
+    for (i = 0; i < src->span_count; ++i) {
+        const DataSpan *sp = &src->spans[i];
+        if (!add_data_span(dst, sp->line, sp->dc + dc_base, sp->words, sp->string)) return 0;
+    }
+    src->span_count = 0;
+    need = dst->stmt_count + src->stmt_count;
+    if (need > dst->stmt_cap) {
+        int newcap = dst->stmt_cap ? dst->stmt_cap : 64;
+        Statement *grown;
+        while (newcap < need) newcap *= 2;
+        grown = (Statement *)as_realloc(dst->stmts, (size_t)newcap * sizeof(Statement));
+        if (!grown) return 0;
+        dst->stmts = grown;
+        dst->stmt_cap = newcap;
+    }
+    for (i = 0; i < src->stmt_count; ++i) {
+        Statement *st = &dst->stmts[dst->stmt_count++];
+        *st = src->stmts[i];
+        st->ic += ic_base;
+    }
+    src->stmt_count = 0;
+    return 1;
+}
+
+/* sink_from_image — sink that appends like add_code_word/add_fixup */
+void sink_from_image(CodeSink *s, MemoryImage *m) {
+    s->code = m->code;
+    s->ic = m->IC;
+    s->model = m->model;
+    s->fix_slot = m->fix_slot;
+    s->fix_sym = m->fix_sym;
+    s->fix_line = m->fix_line;
+    s->fixup_count = m->fixup_count;
+    s->fixup_cap = MAX_FIXUPS;
+}
+
+/* sink_to_image — copy counters of an image-backed sink back */
+void sink_to_image(const CodeSink *s, MemoryImage *m) {
+    m->IC = s->ic;
+    m->fixup_count = s->fixup_count;
+}
+
+/* alloc_sink_fixups — three arrays of cap entries (at least one) */
+int alloc_sink_fixups(CodeSink *s, int cap) {
+    size_t n = (size_t)(cap > 0 ? cap : 1);
+    s->fix_slot = (unsigned short *)as_malloc(n * sizeof(unsigned short));
+    s->fix_sym = (int *)as_malloc(n * sizeof(int));
+    s->fix_line = (int *)as_malloc(n * sizeof(int));
+    s->fixup_count = 0;
+    s->fixup_cap = cap;
+    if (s->fix_slot && s->fix_sym && s->fix_line) return 1;
+    free_sink_fixups(s);
+    return 0;
+}
+
+/* free_sink_fixups — release and detach the arrays */
+void free_sink_fixups(CodeSink *s) {
+    as_free(s->fix_slot); as_free(s->fix_sym); as_free(s->fix_line);
+    s->fix_slot = NULL; s->fix_sym = NULL; s->fix_line = NULL;
+    s->fixup_count = s->fixup_cap = 0;
+}
+
+/* sink_emit — store word at the sink's slot (model-width masked) */
+void sink_emit(CodeSink *s, int word) {
+    if (s->ic < MAX_CODE_SIZE) {
+        s->code[s->ic++] = (Word)(word & ((1 << s->model->word_bits) - 1));
+    }
+}
+
+/* sink_fixup — record a symbol reference in the sink's arrays */
+void sink_fixup(CodeSink *s, int word_index, int sym, int line) {
+    if (sym < 0 || word_index < 0 || word_index >= MAX_CODE_SIZE || s->fixup_count >= s->fixup_cap) return;
+    s->fix_slot[s->fixup_count] = (unsigned short)word_index;
+    s->fix_sym[s->fixup_count] = sym;
+    s->fix_line[s->fixup_count] = line;
+    s->fixup_count++;
 }
 
-/* add_code_word — append one code word to image (10-bit masked) */
+/* copy_fixup — one fixup from src onto the end of dst, rebased */
+int copy_fixup(CodeSink *dst, const CodeSink *src, int k, int ic_delta, int line_delta) {
+    if (dst->fixup_count >= dst->fixup_cap) return 0;
+    dst->fix_slot[dst->fixup_count] = (unsigned short)(src->fix_slot[k] + ic_delta);
+    dst->fix_sym[dst->fixup_count] = src->fix_sym[k];
+    dst->fix_line[dst->fixup_count] = src->fix_line[k] + line_delta;
+    dst->fixup_count++;
+    return 1;
+}
+
+/* add_code_word — append one code word to image (model-width masked) */
 void add_code_word(MemoryImage *m, int word) {
     if (!m) return;
     if (m->IC < MAX_CODE_SIZE) {
-        m->code[m->IC++] = (word & 0x3FF);
+        m->code[m->IC++] = (Word)(word & ((1 << m->model->word_bits) - 1));
     }
 }
 
-/* add_data_word — append one data word to image (10-bit masked) */
+/* add_data_word — append one data word to image (model-width masked) */
 void add_data_word(MemoryImage *m, int word) {
     if (!m) return;
     if (m->DC < MAX_DATA_SIZE) {
-        m->data[m->DC++] = (word & 0x3FF);
+        m->data[m->DC++] = (Word)(word & ((1 << m->model->word_bits) - 1));
     }
 }
 
+/* add_data_fill — one masked word stored count times, clipped to the image */
+void add_data_fill(MemoryImage *m, int word, int count) {
+    int end;
+    if (!m || count <= 0) return;
+    end = count < MAX_DATA_SIZE - m->DC ? m->DC + count : MAX_DATA_SIZE;
+    word &= (1 << m->model->word_bits) - 1;
+    while (m->DC < end) m->data[m->DC++] = (Word)word;
+}
+
 /* add_fixup — record a symbol reference to be resolved in pass-2 */
-void add_fixup(MemoryImage *m, int word_index, const char *label, int line) {
-    Fixup *fx;
-    if (!m || !label) return;
-    if (m->fixup_count >= MAX_FIXUPS) return;
-    fx = &m->fixups[m->fixup_count++];
-    fx->word_index = word_index;
-    strncpy(fx->label, label, MAX_LABEL_LEN - 1);
-    fx->label[MAX_LABEL_LEN - 1] = '\0';
-    fx->line = line;
+void add_fixup(MemoryImage *m, int word_index, int sym, int line) {
+    CodeSink s;
+    if (!m) return;
+    sink_from_image(&s, m);
+    sink_fixup(&s, word_index, sym, line);
+    m->fixup_count = s.fixup_count;
 }
 
@@ -0,0 +1,230 @@
+/* object_reader.c
+ * Letters are decoded two at a time through a 64K-entry table indexed by the
+ * raw byte pair, so a 4-letter address takes two lookups and a 5-letter word
+ * three. Lines are walked straight through the mapping, never copied.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "object_reader.h"
+#include "alloc_stats.h"
+
+#define LOGICAL_BASE 100
+
+/* g_pair — value of the letter pair "aa".."dd" (0..15); 0xFF if not a pair */
+static unsigned char g_pair[1 << 16];
+static int g_tables_built = 0;
+
+/* build_tables — fill the pair table once */
+static void build_tables(void)
+{
+    int a, b;
+    if (g_tables_built) return;
+    memset(g_pair, 0xFF, sizeof(g_pair));
+    for (a = 0; a < 4; ++a)
+        for (b = 0; b < 4; ++b)
+            g_pair[((unsigned)('a' + a) << 8) | (unsigned)('a' + b)] = (unsigned char)(a * 4 + b);
+    g_tables_built = 1;
+}
+
+/* b4_decode — exactly n letters (an odd one first, then pairs); -1 on bad input */
+static long b4_decode(const char *s, int n)
+{
+    long v = 0;
+    int i = 0;
+    if (n & 1) {
+        unsigned d = (unsigned)(unsigned char)s[0] - 'a';
+        if (d > 3) return -1;
+        v = (long)d;
+        i = 1;
+    }
+    for (; i < n; i += 2) {
+        unsigned p = g_pair[((unsigned)(unsigned char)s[i] << 8) | (unsigned char)s[i + 1]];
+        if (p == 0xFF) return -1;
+        v = (v << 4) | (long)p;
+    }
+    return v;
+}
+
+/* Mapped — a read-only file mapping (len 0: empty file, nothing mapped) */
+typedef struct {
+    const char *data;
+    size_t len;
+} Mapped;
+
+/* map_file — 1 mapped, 0 missing/unreadable */
+static int map_file(const char *path, Mapped *m)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    void *p;
+
+    m->data = "";
+    m->len = 0;
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) != 0) { close(fd); return 0; }
+    if (st.st_size > 0) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { close(fd); return 0; }
+        m->data = (const char *)p;
+        m->len = (size_t)st.st_size;
+    }
+    close(fd);
+    return 1;
+}
+
+/* unmap_file — drop a mapping from map_file */
+static void unmap_file(Mapped *m)
+{
+    if (m->len) munmap((void *)m->data, m->len);
+    m->len = 0;
+}
+
+/* next_line — [*at, end-of-line) without the newline or a trailing CR;
+ * advances *at past the newline; 0 at end of file */
+static int next_line(const Mapped *m, size_t *at, const char **line, int *len)
+{
+    const char *s, *nl;
+    size_t rest;
+    if (*at >= m->len) return 0;
+    s = m->data + *at;
+    rest = m->len - *at;
+    nl = (const char *)memchr(s, '\n', rest);
+    *len = nl ? (int)(nl - s) : (int)rest;
+    *at += (size_t)*len + (nl ? 1 : 0);
+    if (*len > 0 && s[*len - 1] == '\r') --*len;
+    *line = s;
+    return 1;
+}
+
+/* read_object_image — header "<code> <data>", then one "<addr> <word>" per word */
+int read_object_image(const char *path, const MemoryModel *mm, MemoryImage *mem)
+{
+    Mapped m;
+    size_t at = 0;
+    const char *line;
+    int len, line_no = 1, n = 0, hd = mm->word_digits;
+    int alen = mm->addr_digits, wlen = mm->word_digits;
+    long code, data;
+
+    build_tables();
+    init_memory_image(mem);
+    mem->model = mm;
+    if (!map_file(path, &m)) { fprintf(stderr, "[error] cannot open %s\n", path); return 0; }
+
+    if (!next_line(&m, &at, &line, &len) || len != 2 * hd + 1 || line[hd] != ' ' ||
+        (code = b4_decode(line, hd)) < 0 || (data = b4_decode(line + hd + 1, hd)) < 0 ||
+        code > MAX_CODE_SIZE || data > MAX_DATA_SIZE || LOGICAL_BASE + code + data > mm->mem_top) {
+        fprintf(stderr, "[error] %s:1: malformed header\n", path);
+        unmap_file(&m);
+        return 0;
+    }
+
+    while (next_line(&m, &at, &line, &len)) {
+        long a, w;
+        line_no++;
+        if (len == 0) continue;
+        if (len != alen + 1 + wlen || line[alen] != ' ' ||
+            (a = b4_decode(line, alen)) < 0 || (w = b4_decode(line + alen + 1, wlen)) < 0) {
+            fprintf(stderr, "[error] %s:%d: malformed word line\n", path, line_no);
+            unmap_file(&m);
+            return 0;
+        }
+        if (n >= code + data || a != LOGICAL_BASE + n) {
+            fprintf(stderr, "[error] %s:%d: %s\n", path, line_no,
+                    n >= code + data ? "more words than the header promises" : "address out of sequence");
+            unmap_file(&m);
+            return 0;
+        }
+        if (n < code) mem->code[n] = (Word)w;
+        else mem->data[n - code] = (Word)w;
+        n++;
+    }
+    unmap_file(&m);
+    if (n != code + data) {
+        fprintf(stderr, "[error] %s: header promises %ld words, found %d\n", path, code + data, n);
+        return 0;
+    }
+    mem->IC = (int)code;
+    mem->DC = (int)data;
+    return 1;
+}
+
+/* read_object_refs — one ref per non-empty line, table sized by newlines */
+int read_object_refs(const char *path, const MemoryModel *mm, ObjRef **refs, int *count)
+{
+    Mapped m;
+    size_t at = 0, k;
+    const char *line;
+    int len, line_no = 0, cap = 1, ok = 1, alen = mm->addr_digits;
+    ObjRef *out;
+
+    build_tables();
+    *refs = NULL;
+    *count = 0;
+    if (!map_file(path, &m)) return 1;   /* optional file */
+
+    for (k = 0; k < m.len; ++k) if (m.data[k] == '\n') cap++;
+    out = (ObjRef *)as_malloc((size_t)cap * sizeof(ObjRef));
+    if (!out) { unmap_file(&m); fprintf(stderr, "[error] %s: out of memory\n", path); return 0; }
+
+    while (next_line(&m, &at, &line, &len)) {
+        int name_len = len - alen - 1;
+        long a;
+        line_no++;
+        if (len == 0) continue;
+        if (name_len < 1 || name_len >= MAX_LABEL_LEN || line[name_len] != ' ' ||
+            memchr(line, ' ', (size_t)name_len) != NULL ||
+            (a = b4_decode(line + name_len + 1, alen)) < 0 || a >= mm->mem_top) {
+            fprintf(stderr, "[error] %s:%d: malformed line\n", path, line_no);
+            ok = 0;
+            continue;
+        }
+        memcpy(out[*count].name, line, (size_t)name_len);
+        out[*count].name[name_len] = '\0';
+        out[*count].address = (int)a;
+        ++*count;
+    }
+    unmap_file(&m);
+    *refs = out;
+    return ok;
+}
+
+/* read_object_file — image first; the ref files are only read if it parsed */
+int read_object_file(const char *base, const MemoryModel *mm, ObjectFile *obj)
+{
+    char path[600];
+    int ok;
+
+    obj->ents = obj->exts = NULL;
+    obj->ent_count = obj->ext_count = 0;
+    if (strlen(base) + 5 > sizeof(path)) {
+        fprintf(stderr, "[error] %s: path too long\n", base);
+        init_memory_image(&obj->mem);
+        return 0;
+    }
+    sprintf(path, "%s.ob", base);
+    if (!read_object_image(path, mm, &obj->mem)) return 0;
+    sprintf(path, "%s.ent", base);
+    ok = read_object_refs(path, mm, &obj->ents, &obj->ent_count);
+    sprintf(path, "%s.ext", base);
+    if (!read_object_refs(path, mm, &obj->exts, &obj->ext_count)) ok = 0;
+    return ok;
+}
+
+/* free_object_file — tables from as_malloc */
+void free_object_file(ObjectFile *obj)
+{
+    as_free(obj->ents);
+    as_free(obj->exts);
+    obj->ents = obj->exts = NULL;
+    obj->ent_count = obj->ext_count = 0;
+    free_memory_image(&obj->mem);
+}
@@ -1,23 +1,40 @@
 /* output_files.c
  * Writes .ob/.ent/.ext files in custom base-4; tracks extern symbol uses.
  * Formats addresses/words and derives base name from source.
+ * .ob lines have a fixed width, so single lines can be rewritten in place.
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include "output_files.h"
+#include "trace.h"
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 /* ---- extern-use collector ---------------------------------------------- */
 
-typedef struct {
-    char name[MAX_LABEL_LEN];
-    int  address;                 /* absolute address (decimal) */
-} ExtUse;
+/* one entry per extern use, as parallel arrays; names point into the
+ * symbol table, which outlives the write */
+#define MAX_EXT_USES MAX_FIXUPS
+
+static const char    *g_ext_name[MAX_EXT_USES];
+static unsigned short g_ext_addr[MAX_EXT_USES];   /* absolute address (decimal) */
+static int            g_ext_use_count = 0;
 
-#define MAX_EXT_USES 1024
+static int g_output_extras = 0;
+
+/* set_output_extras — choose the optional outputs */
+void set_output_extras(int flags)
+{
+    g_output_extras = flags;
+}
 
-static ExtUse g_ext_uses[MAX_EXT_USES];
-static int    g_ext_use_count = 0;
+/* output_extras — the optional outputs in effect */
+int output_extras(void)
+{
+    return g_output_extras;
+}
 
 /* of_init — reset recorded extern uses */
 void of_init(void)
@@ -30,16 +47,15 @@ void of_record_extern_use(const char *name, int use_address)
 {
     if (!name) return;
     if (g_ext_use_count >= MAX_EXT_USES) return;
-    strncpy(g_ext_uses[g_ext_use_count].name, name, MAX_LABEL_LEN - 1);
-    g_ext_uses[g_ext_use_count].name[MAX_LABEL_LEN - 1] = '\0';
-    g_ext_uses[g_ext_use_count].address = use_address;
+    g_ext_name[g_ext_use_count] = name;
+    g_ext_addr[g_ext_use_count] = (unsigned short)use_address;
     g_ext_use_count++;
 }
 
 /* ---- base-4 "abcd" helpers --------------------------------------------- */
 
 /* to_base4_letters — write n as base-4 using digits a/b/c/d with fixed width */
-static void to_base4_letters(unsigned int n, int width, char *out)
+void to_base4_letters(unsigned int n, int width, char *out)
 {
     static const char digits[4] = {'a','b','c','d'};
     int i;
@@ -50,18 +66,21 @@ static void to_base4_letters(unsigned int n, int width, char *out)
     out[width] = '\0';
 }
 
-/* addr_to_b4 — 0..255 address → 4 base-4 letters */
-static void addr_to_b4(int addr, char *out4)
+/* B4_BUF — room for the widest address/word of any model (+NUL) */
+#define B4_BUF 16
+
+/* addr_to_b4 — address → addr_digits base-4 letters (4 in classic) */
+static void addr_to_b4(const MemoryModel *mm, int addr, char *out)
 {
-    unsigned int v = (unsigned int)(addr & 0xFF); /* 0..255 */
-    to_base4_letters(v, 4, out4);
+    unsigned int v = (unsigned int)addr & ((1u << (2 * mm->addr_digits)) - 1u);
+    to_base4_letters(v, mm->addr_digits, out);
 }
 
-/* word_to_b4 — 10-bit word → 5 base-4 letters */
-static void word_to_b4(int word, char *out5)
+/* word_to_b4 — machine word → word_digits base-4 letters (5 in classic) */
+static void word_to_b4(const MemoryModel *mm, int word, char *out)
 {
-    unsigned int v = (unsigned int)(word & 0x3FF); /* 10-bit word */
-    to_base4_letters(v, 5, out5);
+    unsigned int v = (unsigned int)word & ((1u << mm->word_bits) - 1u);
+    to_base4_letters(v, mm->word_digits, out);
 }
 
 /* ---- path helper -------------------------------------------------------- */
@@ -87,97 +106,216 @@ static void derive_base_name(const char *src_filename, char *dst, size_t dstsz)
 
 /* ---- writers ------------------------------------------------------------ */
 
-/* write_output_files — emit .ob/.ent/.ext for a compiled source */
-void write_output_files(const char *src_filename,
-                        const MemoryImage *mem,
-                        const Symbol *symbols)
+/* output_path — <base of src><ext> in the current directory */
+void output_path(const char *src_filename, const char *ext, char *out)
 {
     char base[256];
-    char path_ob[300], path_ent[300], path_ext[300];
-    FILE *fob, *fent, *fext;
-    int i, wrote_ent = 0, wrote_ext = 0;
-    int code_size, data_size;
-
-    if (!src_filename || !mem) return;
-
     derive_base_name(src_filename, base, sizeof(base));
+    sprintf(out, "%s%s", base, ext);
+}
 
-    /* Build paths */
-    sprintf(path_ob,  "%s.ob",  base);
-    sprintf(path_ent, "%s.ent", base);
-    sprintf(path_ext, "%s.ext", base);
+/* image_sizes — IC/DC clamped to the image arrays */
+static void image_sizes(const MemoryImage *mem, int *code_size, int *data_size)
+{
+    *code_size = mem->IC;
+    if (*code_size < 0) *code_size = 0;
+    if (*code_size > MAX_CODE_SIZE) *code_size = MAX_CODE_SIZE;
+    *data_size = mem->DC;
+    if (*data_size < 0) *data_size = 0;
+    if (*data_size > MAX_DATA_SIZE) *data_size = MAX_DATA_SIZE;
+}
+
+/* format_header — "<code size> <data size>\n" (word width each) */
+static int format_header(const MemoryModel *mm, int code_size, int data_size, char *out)
+{
+    char b4_code[B4_BUF], b4_data[B4_BUF];
+    to_base4_letters((unsigned int)code_size, mm->word_digits, b4_code);
+    to_base4_letters((unsigned int)data_size, mm->word_digits, b4_data);
+    return sprintf(out, "%s %s\n", b4_code, b4_data);
+}
 
-    /* Sizes: IC and DC are counts already */
-    code_size = mem->IC;
-    if (code_size < 0) code_size = 0;
-    if (code_size > MAX_CODE_SIZE) code_size = MAX_CODE_SIZE;
+/* format_line — "<addr> <word>\n" for image word k (code first, then data) */
+static int format_line(const MemoryModel *mm, const MemoryImage *mem, int code_size, int k, char *out)
+{
+    char a4[B4_BUF], w5[B4_BUF];
+    addr_to_b4(mm, 100 + k, a4);
+    word_to_b4(mm, k < code_size ? mem->code[k] : mem->data[k - code_size], w5);
+    return sprintf(out, "%s %s\n", a4, w5);
+}
 
-    data_size = mem->DC;
-    if (data_size < 0) data_size = 0;
-    if (data_size > MAX_DATA_SIZE) data_size = MAX_DATA_SIZE;
+/* write_object — whole .ob: header, code words at 100.., data after code */
+static void write_object(const char *path, const MemoryImage *mem, const MemoryModel *mm)
+{
+    char line[2 * B4_BUF + 2];
+    int k, code_size, data_size;
+    FILE *fob = fopen(path, "w");
 
-    /* .ob */
-    fob = fopen(path_ob, "w");
     if (!fob) return;
+    image_sizes(mem, &code_size, &data_size);
+    format_header(mm, code_size, data_size, line);
+    fputs(line, fob);
+    for (k = 0; k < code_size + data_size; ++k) {
+        format_line(mm, mem, code_size, k, line);
+        fputs(line, fob);
+    }
+    fclose(fob);
+}
 
-    /* header as base-4 (5 digits each) */
-    {
-        char b4_code[6], b4_data[6];
-        to_base4_letters((unsigned int)code_size, 5, b4_code);
-        to_base4_letters((unsigned int)data_size, 5, b4_data);
-        fprintf(fob, "%s %s\n", b4_code, b4_data);
+/* write_entries — .ent (entries that are not extern); removed when empty */
+static void write_entries(const char *path, const MemoryModel *mm, const Symbol *symbols)
+{
+    FILE *fent = fopen(path, "w");
+    int wrote_ent = 0;
+    const Symbol *s;
+
+    if (!fent) return;
+    for (s = symbols; s; s = s->next) {
+        if (s->is_entry && !s->is_extern) {
+            char a4[B4_BUF];
+            addr_to_b4(mm, s->address, a4);
+            fprintf(fent, "%s %s\n", s->name, a4);
+            wrote_ent = 1;
+        }
     }
+    fclose(fent);
+    if (!wrote_ent) remove(path);
+}
 
-    /* code words at addresses 100.. */
-    for (i = 0; i < code_size; ++i) {
-        int abs_addr = 100 + i;
-        char a4[5], w5[6];
-        addr_to_b4(abs_addr, a4);
-        word_to_b4(mem->code[i], w5);
-        fprintf(fob, "%s %s\n", a4, w5);
+/* write_externals — .ext (each recorded extern use); removed when empty */
+static void write_externals(const char *path, const MemoryModel *mm)
+{
+    FILE *fext;
+    int i;
+
+    if (g_ext_use_count == 0) { remove(path); return; }
+    fext = fopen(path, "w");
+    if (!fext) { remove(path); return; }
+    for (i = 0; i < g_ext_use_count; ++i) {
+        char a4[B4_BUF];
+        addr_to_b4(mm, g_ext_addr[i], a4);
+        fprintf(fext, "%s %s\n", g_ext_name[i], a4);
     }
+    fclose(fext);
+}
+
+/* write_output_files — emit .ob/.ent/.ext for a compiled source */
+void write_output_files(const char *src_filename,
+                        const MemoryImage *mem,
+                        const Symbol *symbols)
+{
+    char path[300];
+    const MemoryModel *mm;
 
-    /* data words appended after code */
-    for (i = 0; i < data_size; ++i) {
-        int abs_addr = 100 + code_size + i;
-        char a4[5], w5[6];
-        addr_to_b4(abs_addr, a4);
-        word_to_b4(mem->data[i], w5);
-        fprintf(fob, "%s %s\n", a4, w5);
+    if (!src_filename || !mem) return;
+    mm = mem->model ? mem->model : default_memory_model();
+
+    TRACE_BEGIN("write_output_files");
+    output_path(src_filename, ".ob", path);
+    write_object(path, mem, mm);
+    output_path(src_filename, ".ent", path);
+    write_entries(path, mm, symbols);
+    output_path(src_filename, ".ext", path);
+    write_externals(path, mm);
+    TRACE_END("write_output_files");
+}
+
+/* write_entry_file — rewrite only .ent */
+void write_entry_file(const char *src_filename, const MemoryImage *mem, const Symbol *symbols)
+{
+    char path[300];
+    if (!src_filename || !mem) return;
+    output_path(src_filename, ".ent", path);
+    write_entries(path, mem->model ? mem->model : default_memory_model(), symbols);
+}
+
+/* write_extern_file — rewrite only .ext from the recorded extern uses */
+void write_extern_file(const char *src_filename, const MemoryImage *mem)
+{
+    char path[300];
+    if (!src_filename || !mem) return;
+    output_path(src_filename, ".ext", path);
+    write_externals(path, mem->model ? mem->model : default_memory_model());
+}
+
+/* put_make_path — a path in make syntax (spaces escaped) */
+static void put_make_path(FILE *fp, const char *path)
+{
+    for (; *path; ++path) {
+        if (*path == ' ' || *path == '#') fputc('\\', fp);
+        else if (*path == '$') fputc('$', fp);
+        fputc(*path, fp);
     }
+}
 
-    fclose(fob);
+/* write_dependency_file — "<base>.ob: <src> <deps...>" plus an empty rule per
+ * dependency, so make keeps going when an included file is deleted */
+void write_dependency_file(const char *src_filename, const char **deps, int ndeps)
+{
+    char path[300];
+    FILE *fp;
+    int i;
 
-    /* .ent (entries that are not extern) */
-    fent = fopen(path_ent, "w");
-    if (fent) {
-        const Symbol *s = symbols;
-        while (s) {
-            if (s->is_entry && !s->is_extern) {
-                char a4[5];
-                addr_to_b4(s->address, a4);
-                fprintf(fent, "%s %s\n", s->name, a4);
-                wrote_ent = 1;
-            }
-            s = s->next;
-        }
-        fclose(fent);
-        if (!wrote_ent) remove(path_ent);
+    if (!src_filename) return;
+    output_path(src_filename, ".d", path);
+    fp = fopen(path, "w");
+    if (!fp) return;
+    output_path(src_filename, ".ob", path);
+    put_make_path(fp, path);
+    fputs(": ", fp);
+    put_make_path(fp, src_filename);
+    for (i = 0; i < ndeps; ++i) {
+        fputs(" \\\n ", fp);
+        put_make_path(fp, deps[i]);
+    }
+    fputc('\n', fp);
+    for (i = 0; i < ndeps; ++i) {
+        fputc('\n', fp);
+        put_make_path(fp, deps[i]);
+        fputs(":\n", fp);
     }
+    fclose(fp);
+}
 
-    /* .ext (each recorded extern use with its absolute address) */
-    if (g_ext_use_count > 0) {
-        fext = fopen(path_ext, "w");
-        if (fext) {
-            for (i = 0; i < g_ext_use_count; ++i) {
-                char a4[5];
-                addr_to_b4(g_ext_uses[i].address, a4);
-                fprintf(fext, "%s %s\n", g_ext_uses[i].name, a4);
-            }
-            fclose(fext);
-            wrote_ext = 1;
+/* update_object_file — overwrite chosen .ob lines in place: the header (if
+ * asked), each listed word, and every word from tail_from on (then trim) */
+int update_object_file(const char *src_filename, const MemoryImage *mem,
+                       int header, const int *slots, int nslots, int tail_from)
+{
+    char path[300], line[2 * B4_BUF + 2];
+    const MemoryModel *mm;
+    long header_len, line_len;
+    int i, code_size, data_size, ok = 1;
+    FILE *fob;
+
+    if (!src_filename || !mem) return 0;
+    mm = mem->model ? mem->model : default_memory_model();
+    output_path(src_filename, ".ob", path);
+    fob = fopen(path, "r+b");
+    if (!fob) return 0;
+
+    image_sizes(mem, &code_size, &data_size);
+    header_len = 2L * mm->word_digits + 2;
+    line_len = (long)mm->addr_digits + mm->word_digits + 2;
+
+    if (header) {
+        format_header(mm, code_size, data_size, line);
+        ok = fseek(fob, 0L, SEEK_SET) == 0 && fputs(line, fob) >= 0;
+    }
+    for (i = 0; ok && i < nslots; ++i) {
+        if (slots[i] < 0 || slots[i] >= code_size + data_size) continue;
+        format_line(mm, mem, code_size, slots[i], line);
+        ok = fseek(fob, header_len + (long)slots[i] * line_len, SEEK_SET) == 0 && fputs(line, fob) >= 0;
+    }
+    if (ok && tail_from >= 0) {
+        int k;
+        ok = fseek(fob, header_len + (long)tail_from * line_len, SEEK_SET) == 0;
+        for (k = tail_from; ok && k < code_size + data_size; ++k) {
+            format_line(mm, mem, code_size, k, line);
+            ok = fputs(line, fob) >= 0;
         }
+        if (ok) ok = fflush(fob) == 0 &&
+                     ftruncate(fileno(fob), header_len + (long)(code_size + data_size) * line_len) == 0;
     }
-    if (!wrote_ext) remove(path_ext);
+    if (fclose(fob) != 0) ok = 0;
+    return ok;
 }
-
@@ -1,35 +1,107 @@
 /* pre_assembler.c
  * Macro expander: collects mcro/endmcro blocks and expands calls into .am.
  * Enforces 80-char logical lines; blocks reserved names (opcodes/regs/dirs).
+ * "mcro NAME a, b" takes positional parameters. Bodies may call other macros;
+ * each is flattened once into literal spans and parameter slots, so a call
+ * is just span copies. `.include "file"` pulls in a file's lines and macros;
+ * included files are parsed once per process and cached.
  */
+
+#define _XOPEN_SOURCE 700      /* realpath, st_mtim */
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "pre_assembler.h"
 #include "error_list.h"
 #include "instruction_set.h" /* for find_instruction */
+#include "alloc_stats.h"
+#include "trace.h"
 
 #define MAX_MACROS       64
 #define MAX_MACRO_NAME   32
+#define MAX_MACRO_PARAMS 8
 #define BUF_LINE_LEN     1024
 #define MAX_LINE_LENGTH  80   /* spec: max logical line length */
+#define MAX_INCLUDES     64   /* distinct files included by one source */
+#define INCLUDE_PATH_LEN 512
+
+enum { LINE_TEXT, LINE_DEF, LINE_INCLUDE };
 
+/* TemplateOp — one step of an expansion: a literal span or a parameter */
 typedef struct {
-    char **lines;     /* body lines */
-    int    count;
-    int    cap;
-} LineBuf;
+    int    param;     /* -1: text[off, off+len); else argument index */
+    size_t off, len;
+} TemplateOp;
 
 typedef struct {
     char    name[MAX_MACRO_NAME];
-    LineBuf body;
+    char    params[MAX_MACRO_PARAMS][MAX_MACRO_NAME];
+    int     param_count;
+    char  **body;     /* raw body lines, borrowed from the file's Unit */
+    int     body_count;
+    int     def_line;
+    int     err_line; /* line in the source that errors about it point at */
+    int     measured; /* expansions can differ from the source lines: check their length */
+    int     state;    /* 0 raw body, 1 being flattened, 2 flattened */
+    char   *text;     /* flattened template: literal pool + ops */
+    size_t  text_len, text_cap;
+    TemplateOp *ops;
+    int     op_count, op_cap;
 } Macro;
 
 static Macro g_macros[MAX_MACROS];
 static int   g_macro_count = 0;
 
+/* Unit — one file split into fgets-sized, NUL-terminated lines */
+typedef struct {
+    char  *path;
+    char  *text;
+    char **lines;
+    unsigned char *kind;  /* LINE_TEXT / LINE_DEF / LINE_INCLUDE */
+    int    count;
+    char **body;          /* body lines of its macros, in order */
+    int    body_count;
+    Macro *macros;        /* its definitions, bodies pointing into body[] */
+    int    macro_count;
+    int    cached;        /* 1: plain malloc, lives in the include cache */
+} Unit;
+
+/* IncludeFile — a parsed include, kept for the rest of the process. It is
+ * found by canonical path (asmd changes directory between jobs, so a
+ * relative path names different files) and reused while the same inode
+ * still has the same size and nanosecond mtime. */
+typedef struct IncludeFile {
+    Unit   unit;          /* unit.path: the spelling this source used */
+    char  *real;          /* realpath: the cache key */
+    dev_t  dev;
+    ino_t  ino;
+    long   size;
+    long   mtime, mtime_ns;
+    struct IncludeFile *next;
+} IncludeFile;
+
+static IncludeFile *g_include_cache = NULL;
+
+/* files used by the current source, in first-use order */
+static IncludeFile *g_used[MAX_INCLUDES];
+static int          g_used_emitted[MAX_INCLUDES];
+static const char  *g_dep_paths[MAX_INCLUDES];
+static int          g_used_count = 0;
+static const char  *g_main_path = NULL;
+
+/* origin of each line of the last .am: file 0 is the source, file k is
+ * g_used[k - 1]; plain malloc, reused from run to run */
+static int  *g_map_file = NULL, *g_map_line = NULL;
+static int   g_map_count = 0, g_map_cap = 0;
+static int   g_map_open = 0;      /* the last line written has no newline yet */
+static int   g_map_ok = 0;        /* 0 after an allocation failure */
+static char  g_map_main[INCLUDE_PATH_LEN];
+
 /* -------- small utils -------- */
 
 /* lstrip — skip leading spaces */
@@ -69,41 +141,18 @@ static int is_valid_macro_name(const char *name) {
     return 1;
 }
 
-/* lb_init — init line buffer */
-static void lb_init(LineBuf *b) { b->lines = NULL; b->count = 0; b->cap = 0; }
-
-/* lb_free — free all owned strings */
-static void lb_free(LineBuf *b) {
-    int i;
-    for (i = 0; i < b->count; i++) free(b->lines[i]);
-    free(b->lines);
-    b->lines = NULL; b->count = b->cap = 0;
-}
-
-/* lb_push — append a copy of line */
-static int lb_push(LineBuf *b, const char *line) {
-    int newcap;
-    char *copy;
-    if (b->count == b->cap) {
-        newcap = (b->cap == 0) ? 8 : b->cap * 2;
-        b->lines = (char**)realloc(b->lines, newcap * sizeof(char*));
-        if (!b->lines) return 0;
-        b->cap = newcap;
-    }
-    copy = (char*)malloc(strlen(line) + 1);
-    if (!copy) return 0;
-    strcpy(copy, line);
-    b->lines[b->count++] = copy;
-    return 1;
-}
-
 /* macros_reset — clear collected macros */
 static void macros_reset(void) {
     int i;
-    for (i = 0; i < g_macro_count; i++) lb_free(&g_macros[i].body);
+    for (i = 0; i < g_macro_count; i++) {
+        as_free(g_macros[i].text);
+        as_free(g_macros[i].ops);
+    }
     g_macro_count = 0;
 }
 
+/* -------- templates -------- */
+
 /* macro_index_by_name — lookup macro slot */
 static int macro_index_by_name(const char *name) {
     int i;
@@ -113,6 +162,211 @@ static int macro_index_by_name(const char *name) {
     return -1;
 }
 
+
+/* tpl_op — append an op; adjacent literal spans are merged */
+static int tpl_op(Macro *m, int param, size_t off, size_t len) {
+    if (param < 0 && len == 0) return 1;
+    if (param < 0 && m->op_count > 0 && m->ops[m->op_count-1].param < 0 &&
+        m->ops[m->op_count-1].off + m->ops[m->op_count-1].len == off) {
+        m->ops[m->op_count-1].len += len;
+        return 1;
+    }
+    if (m->op_count == m->op_cap) {
+        int newcap = m->op_cap ? m->op_cap * 2 : 8;
+        TemplateOp *grown = (TemplateOp*)as_realloc(m->ops, (size_t)newcap * sizeof(TemplateOp));
+        if (!grown) return 0;
+        m->ops = grown;
+        m->op_cap = newcap;
+    }
+    m->ops[m->op_count].param = param;
+    m->ops[m->op_count].off = off;
+    m->ops[m->op_count].len = len;
+    m->op_count++;
+    return 1;
+}
+
+/* param_index — which parameter a word names, or -1 */
+static int param_index(const Macro *m, const char *word, size_t n) {
+    int k;
+    for (k = 0; k < m->param_count; k++)
+        if (strlen(m->params[k]) == n && strncmp(m->params[k], word, n) == 0) return k;
+    return -1;
+}
+
+/* split_args — "x, y" into trimmed args (in place); count, or -1 on an empty one */
+static int split_args(char *p, char *args[], int max_args) {
+    int n = 0;
+    p = lstrip(p);
+    if (!*p) return 0;
+    for (;;) {
+        char *comma = strchr(p, ',');
+        if (comma) *comma = '\0';
+        trim_inplace(p);
+        if (!*p) return -1;
+        if (n == max_args) return max_args + 1;
+        args[n++] = p;
+        if (!comma) return n;
+        p = comma + 1;
+    }
+}
+
+/* find_call — macro called by a trimmed line, or NULL. A macro without
+ * parameters is called only by its bare name; one with parameters by its
+ * name followed by arguments. */
+static Macro *find_call(char *work, char **rest) {
+    char name[MAX_MACRO_NAME];
+    size_t n = 0;
+    int i;
+
+    while (work[n] && !isspace((unsigned char)work[n])) n++;
+    if (n == 0 || n >= MAX_MACRO_NAME) return NULL;
+    memcpy(name, work, n);
+    name[n] = '\0';
+    i = macro_index_by_name(name);
+    if (i < 0) return NULL;
+    *rest = work + n;
+    if (g_macros[i].param_count == 0 && *lstrip(*rest) != '\0') return NULL;
+    return &g_macros[i];
+}
+
+/* pool_append — copy n bytes onto the end of m's literal pool */
+static int pool_append(Macro *m, const char *s, size_t n) {
+    if (m->text_len + n > m->text_cap) {
+        size_t newcap = m->text_cap ? m->text_cap * 2 : 256;
+        char *grown;
+        while (newcap < m->text_len + n) newcap *= 2;
+        grown = (char*)as_realloc(m->text, newcap);
+        if (!grown) return 0;
+        m->text = grown;
+        m->text_cap = newcap;
+    }
+    memcpy(m->text + m->text_len, s, n);
+    m->text_len += n;
+    return 1;
+}
+
+/* emit_raw — append text as one literal span */
+static int emit_raw(Macro *m, const char *s, size_t n) {
+    size_t at = m->text_len;
+    return pool_append(m, s, n) && tpl_op(m, -1, at, n);
+}
+
+/* emit_scanned — append text; m's parameters become slots when they
+ * appear as whole words outside strings and comments */
+static int emit_scanned(Macro *m, const char *s, size_t n) {
+    size_t at = m->text_len, lit, i = 0;
+    int in_str = 0;
+
+    if (!pool_append(m, s, n)) return 0;
+    lit = at;
+    while (i < n && m->param_count > 0) {
+        char c = s[i];
+        if (c == ';' && !in_str) break;
+        if (c == '"') in_str = !in_str;
+        if (!in_str && isalpha((unsigned char)c) && (i == 0 || !isalnum((unsigned char)s[i-1]))) {
+            size_t w = i;
+            int k;
+            while (w < n && isalnum((unsigned char)s[w])) w++;
+            k = param_index(m, s + i, w - i);
+            if (k >= 0) {
+                if (!tpl_op(m, -1, lit, at + i - lit) || !tpl_op(m, k, 0, 0)) return 0;
+                lit = at + w;
+            }
+            i = w;
+            continue;
+        }
+        i++;
+    }
+    return tpl_op(m, -1, lit, at + n - lit);
+}
+
+/* flatten — compile m's body into its template, splicing in the (already
+ * flattened) template of every macro called from it; a call's arguments
+ * may name m's own parameters. Depth-first; a cycle is an error. */
+static int flatten(Macro *m, ErrorList *errors) {
+    int j;
+
+    if (m->state == 2) return 1;
+    if (m->state == 1) {
+        add_error(errors, m->err_line, ERR_MACRO_RECURSION, m->name);
+        return 0;
+    }
+    m->state = 1;
+
+    for (j = 0; j < m->body_count; j++) {
+        const char *line = m->body[j];
+        char work[BUF_LINE_LEN];
+        char *rest, *args[MAX_MACRO_PARAMS];
+        Macro *callee;
+        size_t n = strlen(line);
+        int k, argc;
+
+        strcpy(work, line);
+        trim_inplace(work);
+        callee = find_call(work, &rest);
+        if (!callee) {
+            if (!emit_scanned(m, line, n)) goto oom;
+            if ((n == 0 || line[n-1] != '\n') && !emit_raw(m, "\n", 1)) goto oom;   /* every line ends in \n */
+            continue;
+        }
+
+        if (!flatten(callee, errors)) return 0;
+        m->measured = 1;
+        argc = split_args(rest, args, MAX_MACRO_PARAMS);
+        if (argc != callee->param_count) {
+            add_error(errors, m->err_line, ERR_MACRO_ARGS, callee->name,
+                      callee->param_count, callee->param_count == 1 ? "" : "s");
+            return 0;
+        }
+        for (k = 0; k < callee->op_count; k++) {
+            const TemplateOp *op = &callee->ops[k];
+            int ok = op->param < 0 ? emit_raw(m, callee->text + op->off, op->len)
+                                   : emit_scanned(m, args[op->param], strlen(args[op->param]));
+            if (!ok) goto oom;
+        }
+    }
+    if (m->param_count > 0) m->measured = 1;
+    m->state = 2;
+    return 1;
+
+oom:
+    add_error(errors, m->err_line, ERR_OUT_OF_MEMORY);
+    return 0;
+}
+
+/* parse_params — "a, b, c" into m->params; 0 with a message on bad input */
+static int parse_params(Macro *m, char *p, int line_no, ErrorList *errors) {
+    m->param_count = 0;
+    p = lstrip(p);
+    while (*p) {
+        size_t n = 0;
+        if (m->param_count == MAX_MACRO_PARAMS) { add_error(errors, line_no, ERR_MACRO_DEF, "too many parameters"); return 0; }
+        while (p[n] && p[n] != ',' && !isspace((unsigned char)p[n])) n++;
+        if (n == 0 || n >= MAX_MACRO_NAME || !isalpha((unsigned char)p[0])) {
+            add_error(errors, line_no, ERR_MACRO_DEF, "invalid parameter name");
+            return 0;
+        }
+        memcpy(m->params[m->param_count], p, n);
+        m->params[m->param_count][n] = '\0';
+        {
+            size_t i;
+            for (i = 1; i < n; i++)
+                if (!isalnum((unsigned char)p[i])) { add_error(errors, line_no, ERR_MACRO_DEF, "invalid parameter name"); return 0; }
+        }
+        if (param_index(m, p, n) >= 0) { add_error(errors, line_no, ERR_MACRO_DEF, "duplicate parameter"); return 0; }
+        m->param_count++;
+        p = lstrip(p + n);
+        if (*p == ',') {
+            p = lstrip(p + 1);
+            if (!*p) { add_error(errors, line_no, ERR_MACRO_DEF, "invalid parameter name"); return 0; }
+        } else if (*p) {
+            add_error(errors, line_no, ERR_MACRO_DEF, "expected comma between parameters");
+            return 0;
+        }
+    }
+    return 1;
+}
+
 /* make_out_path — derive "<src>.am" */
 static void make_out_path(const char *src, char *out, size_t out_sz) {
     size_t i, n, last_dot = (size_t)-1;
@@ -139,25 +393,145 @@ static void make_out_path(const char *src, char *out, size_t out_sz) {
 static void check_line_length(const char *line, int line_no, ErrorList *errors) {
     size_t raw_len = strcspn(line, "\r\n");
     if (raw_len > MAX_LINE_LENGTH) {
-        add_error(errors, line_no, "line too long (> 80 chars)");
+        add_error(errors, line_no, ERR_LINE_TOO_LONG, MAX_LINE_LENGTH);
     }
 }
 
 /* -------- parsing & expansion -------- */
 
-/* collect_macros — scan file and store bodies of mcro blocks */
-static int collect_macros(FILE *fp, ErrorList *errors) {
-    char line[BUF_LINE_LEN];
-    int line_no = 0;
-    int in_macro = 0;
+/* -------- units & the include cache -------- */
+
+/* unit_alloc / unit_free_mem — cached units outlive the per-file counters */
+static void *unit_alloc(int cached, size_t n) { return cached ? malloc(n) : as_malloc(n); }
+static void unit_free_mem(int cached, void *p) { if (cached) free(p); else as_free(p); }
+
+/* unit_free — release everything a Unit owns */
+static void unit_free(Unit *u) {
+    unit_free_mem(u->cached, u->path);
+    unit_free_mem(u->cached, u->text);
+    unit_free_mem(u->cached, u->lines);
+    unit_free_mem(u->cached, u->kind);
+    unit_free_mem(u->cached, u->body);
+    unit_free_mem(u->cached, u->macros);
+    memset(u, 0, sizeof(*u));
+}
+
+/* load_unit — read a file and cut it into lines exactly as fgets would
+ * with a BUF_LINE_LEN buffer; 0 if unreadable or out of memory */
+static int load_unit(Unit *u, const char *path, int cached) {
+    FILE *fp;
+    char *raw = NULL;
+    size_t len = 0, cap = 0, got, i, seg;
+    int n;
+
+    memset(u, 0, sizeof(*u));
+    u->cached = cached;
+    fp = fopen(path, "r");
+    if (!fp) return 0;
+    do {
+        if (len == cap) {
+            char *grown;
+            cap = cap ? cap * 2 : 8192;
+            grown = (char*)unit_alloc(cached, cap);
+            if (!grown) { unit_free_mem(cached, raw); fclose(fp); return 0; }
+            if (raw) memcpy(grown, raw, len);
+            unit_free_mem(cached, raw);
+            raw = grown;
+        }
+        got = fread(raw + len, 1, cap - len, fp);
+        len += got;
+    } while (got > 0);
+    fclose(fp);
+
+    /* count segments: a line ends after '\n' or at BUF_LINE_LEN-1 bytes */
+    for (i = 0, seg = 0, n = 0; i < len; i++) {
+        seg++;
+        if (raw[i] == '\n' || seg == BUF_LINE_LEN - 1) { n++; seg = 0; }
+    }
+    if (seg) n++;
+
+    u->path  = (char*)unit_alloc(cached, strlen(path) + 1);
+    u->text  = (char*)unit_alloc(cached, len + (size_t)n + 1);
+    u->lines = (char**)unit_alloc(cached, ((size_t)n + 1) * sizeof(char*));
+    u->kind  = (unsigned char*)unit_alloc(cached, (size_t)n + 1);
+    u->body  = (char**)unit_alloc(cached, ((size_t)n + 1) * sizeof(char*));
+    u->macros = (Macro*)unit_alloc(cached, MAX_MACROS * sizeof(Macro));
+    if (!u->path || !u->text || !u->lines || !u->kind || !u->body || !u->macros) {
+        unit_free_mem(cached, raw);
+        unit_free(u);
+        return 0;
+    }
+    strcpy(u->path, path);
+
+    {
+        char *out = u->text;
+        u->lines[0] = out;
+        for (i = 0, seg = 0; i < len; i++) {
+            *out++ = raw[i];
+            seg++;
+            if (raw[i] == '\n' || seg == BUF_LINE_LEN - 1) {
+                *out++ = '\0';
+                u->lines[++u->count] = out;
+                seg = 0;
+            }
+        }
+        if (seg) { *out++ = '\0'; u->count++; }
+    }
+    unit_free_mem(cached, raw);
+    return 1;
+}
+
+/* include_target — `.include "file"`: 1 and the file name (if out) when
+ * the trimmed line is one; -1 when it starts with .include but is malformed */
+static int include_target(const char *work, char *out, size_t out_sz) {
+    const char *p, *end;
+    if (strncmp(work, ".include", 8) != 0) return 0;
+    if (work[8] != '\0' && work[8] != '"' && !isspace((unsigned char)work[8])) return 0;
+    p = work + 8;
+    while (*p && isspace((unsigned char)*p)) p++;
+    if (*p != '"') return -1;
+    end = strchr(p + 1, '"');
+    if (!end || end == p + 1 || end[1] != '\0' || (size_t)(end - p) > out_sz) return -1;
+    if (out) {
+        memcpy(out, p + 1, (size_t)(end - p - 1));
+        out[end - p - 1] = '\0';
+    }
+    return 1;
+}
+
+/* resolve_include — name relative to the including file's directory */
+static int resolve_include(const char *from, const char *name, char *out) {
+    const char *slash = strrchr(from, '/');
+    size_t dir = (name[0] == '/' || !slash) ? 0 : (size_t)(slash - from) + 1;
+    if (dir + strlen(name) >= INCLUDE_PATH_LEN) return 0;
+    memcpy(out, from, dir);
+    strcpy(out + dir, name);
+    return 1;
+}
+
+/* unit_macro_index — lookup within one file's definitions */
+static int unit_macro_index(const Unit *u, const char *name) {
+    int i;
+    for (i = 0; i < u->macro_count; i++)
+        if (strcmp(u->macros[i].name, name) == 0) return i;
+    return -1;
+}
+
+/* scan_unit — classify lines and record the file's mcro blocks */
+static int scan_unit(Unit *u, ErrorList *errors) {
+    int i, in_macro = 0, line_no = 0;
     Macro *cur = NULL;
 
-    while (fgets(line, sizeof(line), fp)) {
+    for (i = 0; i < u->count; i++) {
+        const char *line = u->lines[i];
         char work[BUF_LINE_LEN];
         char *p;
-        line_no++;
+        line_no = i + 1;
+
+        if (errors_full(errors)) return 0;
 
         check_line_length(line, line_no, errors);
+        u->kind[i] = (unsigned char)(in_macro ? LINE_DEF : LINE_TEXT);
 
         strcpy(work, line);
         trim_inplace(work);
@@ -170,22 +544,30 @@ static int collect_macros(FILE *fp, ErrorList *errors) {
                 char name[MAX_MACRO_NAME] = {0};
                 size_t i2 = 0;
                 p = lstrip(p + 4);
-                if (*p == '\0') { add_error(errors, line_no, "mcro: missing name"); return 0; }
+                if (*p == '\0') { add_error(errors, line_no, ERR_MACRO_DEF, "missing name"); return 0; }
                 while (p[i2] && !isspace((unsigned char)p[i2]) && i2 < MAX_MACRO_NAME-1) {
                     name[i2] = p[i2]; i2++;
                 }
                 name[i2] = '\0';
-                if (!is_valid_macro_name(name)) { add_error(errors, line_no, "mcro: invalid or reserved name"); return 0; }
-                if (macro_index_by_name(name) >= 0) { add_error(errors, line_no, "mcro: duplicate name"); return 0; }
-                if (g_macro_count >= MAX_MACROS) { add_error(errors, line_no, "too many macros"); return 0; }
+                if (!is_valid_macro_name(name)) { add_error(errors, line_no, ERR_MACRO_DEF, "invalid or reserved name"); return 0; }
+                if (unit_macro_index(u, name) >= 0) { add_error(errors, line_no, ERR_MACRO_DEF, "duplicate name"); return 0; }
+                if (u->macro_count >= MAX_MACROS) { add_error(errors, line_no, ERR_TOO_MANY_MACROS); return 0; }
 
-                cur = &g_macros[g_macro_count++];
+                cur = &u->macros[u->macro_count++];
+                memset(cur, 0, sizeof(*cur));
                 strcpy(cur->name, name);
-                lb_init(&cur->body);
+                cur->body = u->body + u->body_count;
+                cur->def_line = line_no;
+                if (!parse_params(cur, p + i2, line_no, errors)) return 0;
+                u->kind[i] = LINE_DEF;
                 in_macro = 1;
                 continue;
             }
-            /* not a mcro line; ignore here */
+            switch (include_target(p, NULL, INCLUDE_PATH_LEN)) {
+            case 1:  u->kind[i] = LINE_INCLUDE; break;
+            case -1: add_error(errors, line_no, ERR_INCLUDE, "expected .include \"file\""); return 0;
+            default: break;
+            }
         } else {
             /* inside macro body: look for endmcro / mcroend */
             if (strcmp(p, "endmcro") == 0 || strcmp(p, "mcroend") == 0) {
@@ -193,105 +575,329 @@ static int collect_macros(FILE *fp, ErrorList *errors) {
                 cur = NULL;
                 continue;
             }
-            /* store raw line (as-is) */
-            if (!lb_push(&g_macros[g_macro_count-1].body, line)) {
-                add_error(errors, line_no, "out of memory");
-                return 0;
-            }
+            /* keep the raw line (as-is) */
+            u->body[u->body_count++] = u->lines[i];
+            cur->body_count++;
         }
     }
 
     if (in_macro) {
-        add_error(errors, line_no, "unterminated macro (missing endmcro)");
+        add_error(errors, line_no, ERR_UNTERMINATED_MACRO);
+        return 0;
+    }
+    return 1;
+}
+
+/* include_fresh — f still describes the file st was taken from */
+static int include_fresh(const IncludeFile *f, const struct stat *st) {
+    return f->dev == st->st_dev && f->ino == st->st_ino && f->size == (long)st->st_size &&
+           f->mtime == (long)st->st_mtim.tv_sec && f->mtime_ns == (long)st->st_mtim.tv_nsec;
+}
+
+/* used_by_source — f is already used by the current source */
+static int used_by_source(const IncludeFile *f) {
+    int i;
+    for (i = 0; i < g_used_count; i++) if (g_used[i] == f) return 1;
+    return 0;
+}
+
+/* include_free — drop one cache entry */
+static void include_free(IncludeFile *f) {
+    unit_free(&f->unit);
+    free(f->real);
+    free(f);
+}
+
+/* load_include — the cached parse of path, re-read only if the file changed */
+static IncludeFile *load_include(const char *path, int err_line, ErrorList *errors) {
+    char msg[BUF_LINE_LEN];
+    IncludeFile *f, **link;
+    ErrorList local;
+    struct stat st;
+    char *real;
+
+    if (stat(path, &st) != 0 || !(real = realpath(path, NULL))) {
+        add_error(errors, err_line, ERR_INCLUDE_OPEN, path);
+        return NULL;
+    }
+    for (link = &g_include_cache; *link; link = &(*link)->next)
+        if (strcmp((*link)->real, real) == 0) break;
+    f = *link;
+    /* already used under another spelling: the caller skips it */
+    if (f && used_by_source(f)) { free(real); return f; }
+    if (f && include_fresh(f, &st)) {
+        free(real);
+        if (strcmp(f->unit.path, path) != 0) {    /* nested includes resolve from here */
+            char *p = (char*)malloc(strlen(path) + 1);
+            if (!p) { add_error(errors, err_line, ERR_OUT_OF_MEMORY); return NULL; }
+            strcpy(p, path);
+            free(f->unit.path);
+            f->unit.path = p;
+        }
+        return f;
+    }
+    if (f) {                                   /* stale: drop and re-read */
+        *link = f->next;
+        include_free(f);
+    }
+
+    f = (IncludeFile*)malloc(sizeof(IncludeFile));
+    if (!f || !load_unit(&f->unit, path, 1)) {
+        free(f);
+        free(real);
+        add_error(errors, err_line, ERR_INCLUDE_READ, path);
+        return NULL;
+    }
+    f->real = real;
+    init_error_list(&local);
+    scan_unit(&f->unit, &local);
+    if (local.head) {
+        format_error_message(msg, sizeof(msg), local.head);
+        add_error(errors, err_line, ERR_INCLUDED, path, local.head->line, msg);
+        free_error_list(&local);
+        include_free(f);
+        return NULL;
+    }
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    f->size = (long)st.st_size;
+    f->mtime = (long)st.st_mtim.tv_sec;
+    f->mtime_ns = (long)st.st_mtim.tv_nsec;
+    f->next = g_include_cache;
+    g_include_cache = f;
+    return f;
+}
+
+/* used_index — slot of an already-used include, or -1 */
+static int used_index(const char *path) {
+    int i;
+    for (i = 0; i < g_used_count; i++)
+        if (strcmp(g_used[i]->unit.path, path) == 0) return i;
+    return -1;
+}
+
+/* register_macro — make a file's definition visible to this source */
+static int register_macro(const Macro *m, int err_line, int top, ErrorList *errors) {
+    Macro *dst;
+
+    if (macro_index_by_name(m->name) >= 0) {
+        if (top) add_error(errors, err_line, ERR_MACRO_DEF, "duplicate name");
+        else add_error(errors, err_line, ERR_INCLUDE_MACRO, m->name);
         return 0;
     }
+    if (g_macro_count >= MAX_MACROS) { add_error(errors, err_line, ERR_TOO_MANY_MACROS); return 0; }
+    dst = &g_macros[g_macro_count++];
+    *dst = *m;
+    dst->err_line = err_line;
+    dst->state = 0;
+    dst->measured = 0;
+    dst->text = NULL;
+    dst->text_len = dst->text_cap = 0;
+    dst->ops = NULL;
+    dst->op_count = dst->op_cap = 0;
+    return 1;
+}
+
+/* use_unit — register a file's macros and, in place, those of the files it
+ * includes; each file is used once per source. top_line is the source
+ * line of the outermost .include (0 while walking the source itself). */
+static int use_unit(const Unit *u, int top_line, ErrorList *errors) {
+    int i, mi = 0;
+
+    for (i = 0; i < u->count; i++) {
+        int err_line = top_line ? top_line : i + 1;
+
+        if (mi < u->macro_count && u->macros[mi].def_line == i + 1) {
+            if (!register_macro(&u->macros[mi++], err_line, !top_line, errors)) return 0;
+        } else if (u->kind[i] == LINE_INCLUDE) {
+            char work[BUF_LINE_LEN], name[INCLUDE_PATH_LEN], path[INCLUDE_PATH_LEN];
+            IncludeFile *f;
+
+            strcpy(work, u->lines[i]);
+            trim_inplace(work);
+            include_target(work, name, sizeof(name));
+            if (!resolve_include(u->path, name, path)) { add_error(errors, err_line, ERR_INCLUDE, "path too long"); return 0; }
+            if (used_index(path) >= 0 || strcmp(path, g_main_path) == 0) continue;
+            f = load_include(path, err_line, errors);
+            if (!f) return 0;
+            if (used_by_source(f)) continue;
+            if (g_used_count >= MAX_INCLUDES) { add_error(errors, err_line, ERR_INCLUDE, "too many files"); return 0; }
+            g_used_emitted[g_used_count] = 0;
+            g_dep_paths[g_used_count] = f->unit.path;
+            g_used[g_used_count++] = f;
+            if (!use_unit(&f->unit, err_line, errors)) return 0;
+        }
+    }
     return 1;
 }
 
-/* expand_to — copy src->out, skip defs, expand exact-name macro calls */
-static int expand_to(FILE *fp_in, FILE *fp_out, ErrorList *errors) {
-    char line[BUF_LINE_LEN];
-    int line_no = 0;
+/* -------- parsing & expansion -------- */
+
+/* collect_macros — register the source's macros (and included ones), then
+ * flatten every body once, so a call never expands nested macros */
+static int collect_macros(Unit *src, ErrorList *errors) {
+    int i, ok;
+    TRACE_BEGIN("collect_macros");
+    ok = scan_unit(src, errors) && use_unit(src, 0, errors);
+    for (i = 0; ok && i < g_macro_count; i++)
+        ok = flatten(&g_macros[i], errors);
+    TRACE_END("collect_macros");
+    return ok;
+}
+
+/* map_reset — empty line map for a new .am */
+static void map_reset(const char *src_path) {
+    g_map_count = 0;
+    g_map_open = 0;
+    g_map_ok = 1;
+    strncpy(g_map_main, src_path, sizeof(g_map_main) - 1);
+    g_map_main[sizeof(g_map_main) - 1] = '\0';
+}
+
+/* map_add — origin of the next .am line */
+static void map_add(int file, int line) {
+    if (!g_map_ok) return;
+    if (g_map_count == g_map_cap) {
+        int cap = g_map_cap ? g_map_cap * 2 : 256;
+        int *f = (int*)realloc(g_map_file, (size_t)cap * sizeof(int));
+        int *l;
+        if (f) g_map_file = f;
+        l = f ? (int*)realloc(g_map_line, (size_t)cap * sizeof(int)) : NULL;
+        if (!l) { g_map_ok = 0; return; }
+        g_map_line = l;
+        g_map_cap = cap;
+    }
+    g_map_file[g_map_count] = file;
+    g_map_line[g_map_count++] = line;
+}
+
+/* am_write — write n bytes to the .am; each line they start maps to (file, line) */
+static void am_write(FILE *fp_out, const char *s, size_t n, int file, int line) {
+    const char *end = s + n, *nl;
+    fwrite(s, 1, n, fp_out);
+    while (s < end) {
+        if (!g_map_open) { map_add(file, line); g_map_open = 1; }
+        nl = (const char*)memchr(s, '\n', (size_t)(end - s));
+        if (!nl) break;
+        g_map_open = 0;
+        s = nl + 1;
+    }
+}
+
+/* unit_file — map index of a unit: 0 for the source, k for g_used[k - 1] */
+static int unit_file(const Unit *u) {
+    int k;
+    for (k = 0; k < g_used_count; k++) if (&g_used[k]->unit == u) return k + 1;
+    return 0;
+}
+
+/* expand_call — write a macro's template with args in its parameter slots;
+ * its lines map to the call at (file, line). 0 if a line it produced is too
+ * long (only measured when that can happen) */
+static int expand_call(const Macro *m, char *args[], FILE *fp_out, int file, int line) {
+    size_t col = 0, longest = 0;
+    int k;
+    for (k = 0; k < m->op_count; k++) {
+        const TemplateOp *op = &m->ops[k];
+        const char *s = op->param < 0 ? m->text + op->off : args[op->param];
+        size_t n = op->param < 0 ? op->len : strlen(s);
+        am_write(fp_out, s, n, file, line);
+        if (m->measured) {
+            const char *nl, *end = s + n;
+            while ((nl = (const char*)memchr(s, '\n', (size_t)(end - s))) != NULL) {
+                col += (size_t)(nl - s);
+                if (col > longest) longest = col;
+                col = 0;
+                s = nl + 1;
+            }
+            col += (size_t)(end - s);
+        }
+    }
+    if (col > longest) longest = col;
+    return longest <= MAX_LINE_LENGTH;
+}
+
+/* expand_to — copy a file's lines to out: skip defs, expand macro calls,
+ * splice each included file in at its first .include */
+static int expand_to(const Unit *u, int top_line, FILE *fp_out, ErrorList *errors) {
+    int i, ok = 1, file = unit_file(u);
 
-    while (fgets(line, sizeof(line), fp_in)) {
+    TRACE_BEGIN_ARG("expand_to", u->path);
+    for (i = 0; i < u->count; i++) {
+        const char *line = u->lines[i];
+        int line_no = top_line ? top_line : i + 1;
         char work[BUF_LINE_LEN];
-        char *p;
-        int i;
+        char *rest;
+        const Macro *m;
 
-        line_no++;
-        check_line_length(line, line_no, errors);
+        if (errors_full(errors)) { ok = 0; break; }
+
+        /* skip macro definition blocks entirely */
+        if (u->kind[i] == LINE_DEF) continue;
 
         strcpy(work, line);
         trim_inplace(work);
 
-        /* skip macro definition blocks entirely */
-        if (*work && *work != ';') {
-            p = work;
-            if (strncmp(p, "mcro", 4) == 0 && (p[4] == '\0' || isspace((unsigned char)p[4]))) {
-                /* skip until endmcro / mcroend */
-                while (fgets(line, sizeof(line), fp_in)) {
-                    line_no++;
-                    check_line_length(line, line_no, errors);
-                    strcpy(work, line);
-                    trim_inplace(work);
-                    if (strcmp(work, "endmcro") == 0 || strcmp(work, "mcroend") == 0) break;
-                }
-                continue; /* do not write mcro/endmcro to output */
+        if (u->kind[i] == LINE_INCLUDE) {
+            char name[INCLUDE_PATH_LEN], path[INCLUDE_PATH_LEN];
+            int k;
+            include_target(work, name, sizeof(name));
+            resolve_include(u->path, name, path);
+            k = used_index(path);
+            if (k >= 0 && !g_used_emitted[k]) {
+                g_used_emitted[k] = 1;
+                if (!expand_to(&g_used[k]->unit, line_no, fp_out, errors)) ok = 0;
             }
+            continue;
         }
 
-        /* try macro substitution: line must be exactly a macro name (ignoring spaces) */
-        for (i = 0; i < g_macro_count; i++) {
-            if (strcmp(work, g_macros[i].name) == 0) {
-                /* write body */
-                int j;
-                for (j = 0; j < g_macros[i].body.count; j++) {
-                    fputs(g_macros[i].body.lines[j], fp_out);
-                    /* ensure newline at end (preserve if already present) */
-                    if (g_macros[i].body.lines[j][0] != '\0') {
-                        size_t L = strlen(g_macros[i].body.lines[j]);
-                        if (L == 0 || g_macros[i].body.lines[j][L-1] != '\n')
-                            fputc('\n', fp_out);
-                    } else {
-                        fputc('\n', fp_out);
-                    }
-                }
-                break; /* handled */
+        /* macro call: "NAME" or "NAME arg, arg" */
+        m = find_call(work, &rest);
+        if (m) {
+            char *args[MAX_MACRO_PARAMS];
+            int n = split_args(rest, args, MAX_MACRO_PARAMS);
+            if (n != m->param_count) {
+                add_error(errors, line_no, ERR_MACRO_ARGS, m->name,
+                          m->param_count, m->param_count == 1 ? "" : "s");
+                ok = 0;
+                continue;
+            }
+            if (!expand_call(m, args, fp_out, file, i + 1)) {
+                add_error(errors, line_no, ERR_EXPANSION_TOO_LONG, MAX_LINE_LENGTH, m->name);
+                ok = 0;
             }
+            continue;
         }
-        if (i < g_macro_count) continue; /* was a macro call; already emitted body */
 
         /* otherwise, pass original line through unchanged */
-        fputs(line, fp_out);
+        am_write(fp_out, line, strlen(line), file, i + 1);
     }
-    return 1;
+    TRACE_END("expand_to");
+    return ok;
 }
 
 /* -------- public API -------- */
 
-/* pre_assemble — run collect+expand, produce .am next to src */
-int pre_assemble(const char *src_path,
-                 char *out_path, size_t out_path_sz,
-                 ErrorList *errors)
+/* run_pre_assemble — pre_assemble without its trace span */
+static int run_pre_assemble(const char *src_path,
+                            char *out_path, size_t out_path_sz,
+                            ErrorList *errors)
 {
-    FILE *fin = NULL, *fout = NULL;
-    long pos;
+    FILE *fout = NULL;
+    Unit src;
+    int before = errors->count;
 
     macros_reset();
+    g_used_count = 0;
 
-    if (!src_path || !*src_path) { add_error(errors, 0, "pre_assemble: empty path"); return 0; }
+    if (!src_path || !*src_path) { add_error(errors, 0, ERR_PRE_ASSEMBLE, "empty path"); return 0; }
 
-    /* open input */
-    fin = fopen(src_path, "r");
-    if (!fin) { add_error(errors, 0, "pre_assemble: cannot open source"); return 0; }
+    /* read input */
+    if (!load_unit(&src, src_path, 0)) { add_error(errors, 0, ERR_PRE_ASSEMBLE, "cannot open source"); return 0; }
+    g_main_path = src_path;
 
     /* pass 1: collect macros */
-    if (!collect_macros(fin, errors)) { fclose(fin); macros_reset(); return 0; }
-
-    /* rewind and expand to .am */
-    pos = ftell(fin);
-    (void)pos; /* silence unused */
-    rewind(fin);
+    if (!collect_macros(&src, errors)) { unit_free(&src); macros_reset(); return 0; }
 
     if (out_path && out_path_sz > 0) {
         make_out_path(src_path, out_path, out_path_sz);
@@ -313,18 +919,49 @@ int pre_assemble(const char *src_path,
         }
 
         fout = fopen(target, "w");
-        if (!fout) { fclose(fin); macros_reset(); add_error(errors, 0, "pre_assemble: cannot open output"); return 0; }
+        if (!fout) { unit_free(&src); macros_reset(); add_error(errors, 0, ERR_PRE_ASSEMBLE, "cannot open output"); return 0; }
 
-        if (!expand_to(fin, fout, errors)) {
-            fclose(fin); fclose(fout); macros_reset();
-            add_error(errors, 0, "pre_assemble: expand failed");
+        /* pass 2: expand to .am */
+        map_reset(src_path);
+        if (!expand_to(&src, 0, fout, errors)) {
+            unit_free(&src); fclose(fout); macros_reset();
+            if (errors->count == before) add_error(errors, 0, ERR_PRE_ASSEMBLE, "expand failed");
             return 0;
         }
         fclose(fout);
     }
 
-    fclose(fin);
+    unit_free(&src);
     macros_reset();
-    return 1;
+    return errors->count == before;     /* e.g. overlong lines: stop before pass 1 */
+}
+
+/* pre_assemble — run collect+expand, produce .am next to src */
+int pre_assemble(const char *src_path,
+                 char *out_path, size_t out_path_sz,
+                 ErrorList *errors)
+{
+    int ok;
+    TRACE_BEGIN_ARG("pre_assemble", src_path);
+    ok = run_pre_assemble(src_path, out_path, out_path_sz, errors);
+    TRACE_END("pre_assemble");
+    return ok;
 }
 
+/* pre_assemble_deps — files included by the last run, in first-use order */
+int pre_assemble_deps(const char ***paths)
+{
+    *paths = g_dep_paths;
+    return g_used_count;
+}
+
+/* pre_assemble_origin — map a line of the last .am back to its file and line */
+int pre_assemble_origin(int am_line, const char **file, int *line)
+{
+    int f;
+    if (!g_map_ok || am_line < 1 || am_line > g_map_count) return 0;
+    f = g_map_file[am_line - 1];
+    *file = f == 0 ? g_map_main : g_used[f - 1]->unit.path;
+    *line = g_map_line[am_line - 1];
+    return 1;
+}
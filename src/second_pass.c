@@ -1,10 +1,15 @@
 /* second_pass.c
  * Pass 2: encode instructions into code image, resolve symbols,
  * patch extern/internal refs, and write output files (.ob/.ent/.ext).
+ * Statements are encoded at the IC slots pass 1 gave them, optionally
+ * split across threads.
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "second_pass.h"
 #include "instruction_encoder.h"
@@ -12,6 +17,9 @@
 #include "memory_image.h"
 #include "error_list.h"
 #include "output_files.h"
+#include "xref.h"
+#include "alloc_stats.h"
+#include "trace.h"
 
 #ifndef ARE_A
 #define ARE_A 0
@@ -24,101 +32,189 @@
 #endif
 
 #define LOGICAL_BASE       100
-#define MAX_LINE_LENGTH     80
-
-/* strip_comment/lstrip/rstrip/trim — simple string cleanup */
-static void strip_comment(char *s){ for(;*s;++s){ if(*s==';'){*s='\0';break;} } }
-static char *lstrip(char *s){ while(*s && (*s==' '||*s=='\t')) ++s; return s; }
-static void rstrip_inplace(char *s){
-    size_t n = strlen(s);
-    while(n && (s[n-1]=='\n'||s[n-1]=='\r'||s[n-1]==' '||s[n-1]=='\t')) s[--n]='\0';
+
+/* encode ranges below this size are not worth a thread */
+#define MIN_STMTS_PER_JOB 256
+
+static int g_pass2_jobs = 1;
+
+/* EncodeRange — one contiguous run of statements and where it writes */
+typedef struct {
+    MemoryImage *mem;
+    Symbol      *symbols;
+    int          first, last;         /* statements [first, last) */
+    CodeSink     out;                 /* shares mem->code; own fixups */
+    ErrorList   *errors;
+    ErrorList    local_errors;        /* used by worker ranges */
+} EncodeRange;
+
+/* set_pass2_jobs — threads used to encode statements (1 = sequential) */
+void set_pass2_jobs(int jobs)
+{
+    g_pass2_jobs = (jobs < 1) ? 1 : jobs;
 }
-static void trim_inplace(char *s){ char *p=lstrip(s); if(p!=s) memmove(s,p,strlen(p)+1); rstrip_inplace(s); }
 
-/* encode_instructions_from_file — re-encode instructions into mem->code */
-static int encode_instructions_from_file(const char *expanded_path,
-                                         Symbol *symbols,
-                                         MemoryImage *mem,
-                                         ErrorList *errors)
+/* encode_range — encode each statement at its pass-1 IC slot */
+static void encode_range(EncodeRange *r)
 {
-    FILE *fp = fopen(expanded_path, "r");
-    char linebuf[1024]; int line_no = 0;
+    int i;
+    for (i = r->first; i < r->last && !errors_full(r->errors); ++i) {
+        const Statement *st = &r->mem->stmts[i];
+        r->out.ic = st->ic;
+        (void)encode_instruction_to(st->text, r->symbols, &r->out, r->errors, st->line);
+    }
+}
 
-    if (!fp) { add_error(errors, 0, "cannot open expanded source for pass-2"); return 0; }
+/* encode_worker — pthread entry for encode_range */
+static void *encode_worker(void *arg)
+{
+    TRACE_BEGIN("encode range");
+    encode_range((EncodeRange *)arg);
+    TRACE_END("encode range");
+    return NULL;
+}
 
-    mem->IC = 0;
-    mem->fixup_count = 0;
+/* encode_parallel — split statements over jobs threads, then merge fixups
+ * and errors in range order so the result matches sequential encoding.
+ * 0 before anything is encoded if the ranges cannot be set up, so the
+ * caller can encode sequentially instead. */
+static int encode_parallel(Symbol *symbols, MemoryImage *mem, ErrorList *errors, int jobs)
+{
+    EncodeRange *ranges;
+    CodeSink all;
+    pthread_t *tids;
+    int *started;
+    int k, per = (mem->stmt_count + jobs - 1) / jobs;
+
+    ranges = (EncodeRange *)as_malloc((size_t)jobs * sizeof(EncodeRange));
+    tids = (pthread_t *)as_malloc((size_t)jobs * sizeof(pthread_t));
+    started = (int *)as_malloc((size_t)jobs * sizeof(int));
+    if (!ranges || !tids || !started) {
+        as_free(ranges); as_free(tids); as_free(started);
+        return 0;
+    }
 
-    while (fgets(linebuf, sizeof(linebuf), fp)) {
-        size_t raw_len; char work[1024];
-        line_no++;
+    for (k = 0; k < jobs; ++k) {
+        EncodeRange *r = &ranges[k];
+        r->mem = mem;
+        r->symbols = symbols;
+        r->first = k * per;
+        r->last = (k + 1) * per < mem->stmt_count ? (k + 1) * per : mem->stmt_count;
+        if (r->first > r->last) r->first = r->last;
+        init_error_list(&r->local_errors);
+        r->errors = &r->local_errors;
+        r->out.code = mem->code;
+        r->out.ic = 0;
+        r->out.model = mem->model;
+        /* at most two label operands per statement */
+        if (!alloc_sink_fixups(&r->out, 2 * (r->last - r->first))) {
+            while (k-- > 0) free_sink_fixups(&ranges[k].out);
+            as_free(ranges); as_free(tids); as_free(started);
+            return 0;
+        }
+    }
+
+    for (k = 0; k < jobs; ++k) {
+        EncodeRange *r = &ranges[k];
+        started[k] = (pthread_create(&tids[k], NULL, encode_worker, r) == 0);
+        if (!started[k]) encode_range(r); /* no thread: do it here */
+    }
 
-        raw_len = strcspn(linebuf, "\r\n");
-        if (raw_len > MAX_LINE_LENGTH) add_error(errors, line_no, "line too long (> 80 chars)");
+    sink_from_image(&all, mem);
+    for (k = 0; k < jobs; ++k) {
+        EncodeRange *r = &ranges[k];
+        int f;
+        if (started[k]) pthread_join(tids[k], NULL);
 
-        strcpy(work, linebuf);
-        strip_comment(work);
-        trim_inplace(work);
-        if (*work == '\0') continue;
+        /* fixups by slot: ranges are in IC order already */
+        for (f = 0; f < r->out.fixup_count && copy_fixup(&all, &r->out, f, 0, 0); ++f) {}
+        free_sink_fixups(&r->out);
 
-        /* encode instruction (still collect errors if any) */
-        (void)encode_instruction(work, symbols, mem, errors, line_no);
+        /* errors are kept newest-first: put this range's list on top */
+        splice_errors(errors, &r->local_errors);
     }
 
-    fclose(fp);
+    mem->fixup_count = all.fixup_count;
+    as_free(ranges); as_free(tids); as_free(started);
+    trim_errors(errors);
     return 1;
 }
 
+/* encode_statements — encode pass-1 statements straight into their slots */
+static int encode_statements(Symbol *symbols, MemoryImage *mem, ErrorList *errors)
+{
+    int jobs = g_pass2_jobs;
+
+    mem->fixup_count = 0;
+
+    if (jobs > mem->stmt_count / MIN_STMTS_PER_JOB) jobs = mem->stmt_count / MIN_STMTS_PER_JOB;
+    if (jobs > 1 && encode_parallel(symbols, mem, errors, jobs)) return 1;
+
+    {
+        EncodeRange r;
+        r.mem = mem;
+        r.symbols = symbols;
+        r.first = 0;
+        r.last = mem->stmt_count;
+        r.errors = errors;
+        sink_from_image(&r.out, mem);
+        encode_range(&r);
+        mem->fixup_count = r.out.fixup_count;
+    }
+    return 1;
+}
+
+/* fixup_word — the code word a resolved reference to sym becomes */
+int fixup_word(const MemoryModel *mm, const Symbol *sym)
+{
+    int value = sym->address & ((1 << mm->addr_bits) - 1);
+    return (value << 2) | ((sym->is_extern ? ARE_E : ARE_R) & 0x3);
+}
+
 /* second_pass — resolve fixups and write outputs */
 int second_pass(const char *expanded_filename, Symbol **symbols, MemoryImage *mem, ErrorList *errors)
 {
-    int k, had_errors = 0;
+    Symbol **by_id;
+    int k, before, nsyms;
 
     if (!expanded_filename || !symbols || !*symbols || !mem || !errors) {
-        add_error(errors, 0, "second_pass: invalid arguments");
+        add_error(errors, 0, ERR_INTERNAL, "second_pass");
         return 0;
     }
 
     of_init(); /* reset extern-use list */
-
-    /* 1) encode instructions */
-    if (!encode_instructions_from_file(expanded_filename, *symbols, mem, errors)) return 0;
-
-    /* 2) resolve fixups */
+    before = errors->count;
+
+    /* 1) encode instructions (pass-1 statements, IC slots already fixed) */
+    TRACE_BEGIN("encode");
+    k = encode_statements(*symbols, mem, errors);
+    TRACE_END("encode");
+    if (!k || errors->count > before) return 0;   /* bad statements or undefined labels */
+
+    /* 2) resolve fixups: every label was found while encoding */
+    TRACE_BEGIN("resolve fixups");
+    by_id = index_symbols(*symbols, &nsyms);
+    if (!by_id) {
+        add_error(errors, 0, ERR_OUT_OF_MEMORY);
+        TRACE_END("resolve fixups");
+        return 0;
+    }
     for (k = 0; k < mem->fixup_count; ++k) {
-        Fixup *fx = &mem->fixups[k];
-        const Symbol *sym = find_symbol(*symbols, fx->label);
-        int idx = fx->word_index;
-        int abs_addr = LOGICAL_BASE + idx; /* used in .ext file */
-        int are_bits, patched;
-
-        if (!sym) {
-            char msg[256];
-            sprintf(msg, "Undefined label: %s", fx->label);
-            add_error(errors, fx->line, msg);
-            had_errors = 1;
-            continue;
-        }
+        const Symbol *sym = by_id[mem->fix_sym[k]];
+        int idx = mem->fix_slot[k];
 
-        if (sym->is_extern) {
-            are_bits = ARE_E;
-            of_record_extern_use(sym->name, abs_addr);
-        } else {
-            are_bits = ARE_R;
-        }
+        if (sym->is_extern) of_record_extern_use(sym->name, LOGICAL_BASE + idx);
 
-        if (idx >= 0 && idx < MAX_CODE_SIZE) {
-            /* patch code word: high 8 bits = value, low 2 bits = ARE */
-            int value8 = (sym->address & 0xFF);
-            patched = (value8 << 2) | (are_bits & 0x3);
-            mem->code[idx] = patched;
-        }
+        /* patch code word: high addr_bits = value, low 2 bits = ARE */
+        mem->code[idx] = (Word)fixup_word(mem->model, sym);
     }
-
-    if (had_errors) return 0;
+    as_free(by_id);
+    TRACE_END("resolve fixups");
 
     /* 3) write output files */
+    as_set_phase(PHASE_OUTPUT);
     write_output_files(expanded_filename, mem, *symbols);
+    if (output_extras() & OUT_XREF) write_xref_file(expanded_filename, mem, *symbols);
     return 1;
 }
 
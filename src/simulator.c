@@ -0,0 +1,548 @@
+/* simulator.c
+ * Runs assembled .ob images. The code section is decoded once into an array of
+ * pre-resolved instructions, each carrying its handler (call-threaded dispatch).
+ * Supports step/cycle budgets, per-address counters and parallel batch runs.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "memory_image.h"
+#include "instruction_set.h"
+#include "addressing_modes.h"
+#include "object_reader.h"
+
+#define LOGICAL_BASE   100
+#define MAX_CALL_DEPTH 1024
+
+enum { ARE_A = 0, ARE_E = 1, ARE_R = 2 };
+
+/* run outcome (also the process exit status in batch mode) */
+enum { RUN_STOP = 0, RUN_FAULT = 2, RUN_BUDGET = 3 };
+
+struct Machine;
+struct Insn;
+
+/* Handler — executes one instruction, returns the next one (NULL = halt) */
+typedef const struct Insn *(*Handler)(struct Machine *vm, const struct Insn *ip);
+
+/* Operand — decoded operand; ea/value are filled in by the decoder */
+typedef struct {
+    int mode;                         /* ADDR_* or -1 when absent */
+    int value;                        /* immediate value or base address */
+    int reg;                          /* register number (ADDR_REGISTER) */
+    int row, col;                     /* index registers (ADDR_MATRIX) */
+} Operand;
+
+/* Insn — one pre-decoded instruction */
+typedef struct Insn {
+    Handler fn;
+    int     opcode;
+    int     addr;                     /* absolute address of first word */
+    int     size;                     /* words occupied */
+    int     cost;                     /* cycles: words fetched + memory accesses */
+    Operand src, dst;
+    const struct Insn *target;        /* pre-resolved direct jump target */
+} Insn;
+
+/* Machine — one running image */
+typedef struct Machine {
+    const MemoryModel *mm;
+    int   *mem;                       /* mm->mem_top words, sign-extended */
+    int    regs[8];
+    int    zero;                      /* Z flag from the last cmp */
+    int    code_size, data_size;
+    Insn  *code;                      /* decoded instructions */
+    int    insn_count;
+    const Insn **at;                  /* code word index → instruction (or NULL) */
+    const Insn  *stack[MAX_CALL_DEPTH];
+    int    sp;
+    unsigned long *counts;            /* executions per instruction */
+    unsigned long steps, cycles;
+    int    fault;                     /* set by handlers on runtime faults */
+    const char *fault_msg;
+    int    fault_addr;
+} Machine;
+
+/* Options — command-line settings shared by every run */
+typedef struct {
+    const MemoryModel *mm;
+    unsigned long max_steps;          /* 0 = unlimited */
+    unsigned long max_cycles;         /* 0 = unlimited */
+    int mat_cols;                     /* row stride for LABEL[rX][rY] */
+    int show_counts;
+    int jobs;
+} Options;
+
+static Options g_opt;
+
+/* ---- small helpers ------------------------------------------------------ */
+
+/* sext — wrap v to the model word width and sign-extend */
+static int sext(const MemoryModel *mm, long v)
+{
+    long mask = (1L << mm->word_bits) - 1;
+    v &= mask;
+    if (v & (1L << (mm->word_bits - 1))) v -= (1L << mm->word_bits);
+    return (int)v;
+}
+
+/* field_sext — sign-extend an extension-word value field */
+static int field_sext(const MemoryModel *mm, int v)
+{
+    if (v & (1 << (mm->addr_bits - 1))) v -= (1 << mm->addr_bits);
+    return v;
+}
+
+/* fault — record a runtime fault and halt */
+static const Insn *fault(Machine *vm, const Insn *ip, const char *msg)
+{
+    vm->fault = 1;
+    vm->fault_msg = msg;
+    vm->fault_addr = ip->addr;
+    return NULL;
+}
+
+/* ---- operand access ----------------------------------------------------- */
+
+/* effective_address — memory address of a direct/matrix operand */
+static int effective_address(Machine *vm, const Operand *op)
+{
+    if (op->mode == ADDR_MATRIX)
+        return op->value + vm->regs[op->row] * g_opt.mat_cols + vm->regs[op->col];
+    return op->value;
+}
+
+/* read_operand — fetch operand value; sets vm->fault on bad address */
+static int read_operand(Machine *vm, const Operand *op)
+{
+    int ea;
+    if (op->mode == ADDR_IMMEDIATE) return op->value;
+    if (op->mode == ADDR_REGISTER)  return vm->regs[op->reg];
+    ea = effective_address(vm, op);
+    if (ea < 0 || ea >= vm->mm->mem_top) { vm->fault = 1; vm->fault_msg = "address out of range"; return 0; }
+    return vm->mem[ea];
+}
+
+/* write_operand — store v into a register or memory operand */
+static void write_operand(Machine *vm, const Operand *op, long v)
+{
+    int ea;
+    if (op->mode == ADDR_REGISTER) { vm->regs[op->reg] = sext(vm->mm, v); return; }
+    ea = effective_address(vm, op);
+    if (ea < 0 || ea >= vm->mm->mem_top) { vm->fault = 1; vm->fault_msg = "address out of range"; return; }
+    vm->mem[ea] = sext(vm->mm, v);
+}
+
+/* jump_to — resolve a jump operand to the instruction at that address */
+static const Insn *jump_to(Machine *vm, const Insn *ip, const Operand *op)
+{
+    int addr, idx;
+    if (ip->target) return ip->target;
+    addr = (op->mode == ADDR_REGISTER) ? vm->regs[op->reg] : effective_address(vm, op);
+    idx = addr - LOGICAL_BASE;
+    if (idx < 0 || idx >= vm->code_size || !vm->at[idx])
+        return fault(vm, ip, "jump outside instruction boundaries");
+    return vm->at[idx];
+}
+
+/* ---- handlers ----------------------------------------------------------- */
+
+#define NEXT(ip) ((ip) + 1)
+#define CHECK(vm, ip) do { if ((vm)->fault) { (vm)->fault_addr = (ip)->addr; return NULL; } } while (0)
+
+static const Insn *op_mov(Machine *vm, const Insn *ip)
+{
+    int v = read_operand(vm, &ip->src); CHECK(vm, ip);
+    write_operand(vm, &ip->dst, v);     CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_cmp(Machine *vm, const Insn *ip)
+{
+    int a = read_operand(vm, &ip->src), b;
+    CHECK(vm, ip);
+    b = read_operand(vm, &ip->dst);     CHECK(vm, ip);
+    vm->zero = (sext(vm->mm, (long)a - b) == 0);
+    return NEXT(ip);
+}
+
+static const Insn *op_add(Machine *vm, const Insn *ip)
+{
+    int a = read_operand(vm, &ip->src), b;
+    CHECK(vm, ip);
+    b = read_operand(vm, &ip->dst);     CHECK(vm, ip);
+    write_operand(vm, &ip->dst, (long)b + a); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_sub(Machine *vm, const Insn *ip)
+{
+    int a = read_operand(vm, &ip->src), b;
+    CHECK(vm, ip);
+    b = read_operand(vm, &ip->dst);     CHECK(vm, ip);
+    write_operand(vm, &ip->dst, (long)b - a); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_not(Machine *vm, const Insn *ip)
+{
+    int v = read_operand(vm, &ip->dst); CHECK(vm, ip);
+    write_operand(vm, &ip->dst, ~(long)v); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_clr(Machine *vm, const Insn *ip)
+{
+    write_operand(vm, &ip->dst, 0); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_lea(Machine *vm, const Insn *ip)
+{
+    write_operand(vm, &ip->dst, effective_address(vm, &ip->src)); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_inc(Machine *vm, const Insn *ip)
+{
+    int v = read_operand(vm, &ip->dst); CHECK(vm, ip);
+    write_operand(vm, &ip->dst, (long)v + 1); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_dec(Machine *vm, const Insn *ip)
+{
+    int v = read_operand(vm, &ip->dst); CHECK(vm, ip);
+    write_operand(vm, &ip->dst, (long)v - 1); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_jmp(Machine *vm, const Insn *ip)
+{
+    return jump_to(vm, ip, &ip->dst);
+}
+
+static const Insn *op_bne(Machine *vm, const Insn *ip)
+{
+    return vm->zero ? NEXT(ip) : jump_to(vm, ip, &ip->dst);
+}
+
+static const Insn *op_red(Machine *vm, const Insn *ip)
+{
+    int c = getchar();
+    write_operand(vm, &ip->dst, c == EOF ? -1 : c); CHECK(vm, ip);
+    return NEXT(ip);
+}
+
+static const Insn *op_prn(Machine *vm, const Insn *ip)
+{
+    int v = read_operand(vm, &ip->dst); CHECK(vm, ip);
+    printf("%d\n", v);
+    return NEXT(ip);
+}
+
+static const Insn *op_jsr(Machine *vm, const Insn *ip)
+{
+    if (vm->sp >= MAX_CALL_DEPTH) return fault(vm, ip, "call stack overflow");
+    vm->stack[vm->sp++] = NEXT(ip);
+    return jump_to(vm, ip, &ip->dst);
+}
+
+static const Insn *op_rts(Machine *vm, const Insn *ip)
+{
+    if (vm->sp == 0) return fault(vm, ip, "rts with empty call stack");
+    return vm->stack[--vm->sp];
+}
+
+static const Insn *op_stop(Machine *vm, const Insn *ip)
+{
+    (void)vm; (void)ip;
+    return NULL;
+}
+
+/* handler per opcode (order matches instruction_set.c) */
+static const Handler g_handlers[NUM_OPCODES] = {
+    op_mov, op_cmp, op_add, op_sub, op_not, op_clr, op_lea, op_inc,
+    op_dec, op_jmp, op_bne, op_red, op_prn, op_jsr, op_rts, op_stop
+};
+
+/* ---- loading & decoding ------------------------------------------------- */
+
+/* image_base — arg without its extension (image.ob and image both name the
+ * image, as for the linker and disassembler); 0 if it does not fit */
+static int image_base(const char *arg, char *base, size_t size)
+{
+    const char *dot = strrchr(arg, '.'), *slash = strrchr(arg, '/');
+    size_t blen = (dot && (!slash || dot > slash)) ? (size_t)(dot - arg) : strlen(arg);
+
+    if (blen >= size) { fprintf(stderr, "[error] %s: path too long\n", arg); return 0; }
+    memcpy(base, arg, blen); base[blen] = '\0';
+    return 1;
+}
+
+/* load_image — read <base>.ob through the object reader into vm->mem; 0 on error */
+static int load_image(const char *arg, Machine *vm)
+{
+    char path[520];
+    MemoryImage *img;
+    int i, ok;
+
+    if (!image_base(arg, path, sizeof(path) - 3)) return 0;
+    strcat(path, ".ob");
+
+    img = (MemoryImage*)malloc(sizeof(MemoryImage));
+    if (!img) { fprintf(stderr, "[error] out of memory\n"); return 0; }
+    ok = read_object_image(path, vm->mm, img);
+    if (ok) {
+        vm->code_size = img->IC;
+        vm->data_size = img->DC;
+        for (i = 0; i < img->IC; ++i) vm->mem[LOGICAL_BASE + i] = img->code[i];
+        for (i = 0; i < img->DC; ++i) vm->mem[LOGICAL_BASE + img->IC + i] = sext(vm->mm, img->data[i]);
+    }
+    free_memory_image(img);
+    free(img);
+    return ok;
+}
+
+/* decode_operand — consume extension word(s) at *pc for one operand */
+static int decode_operand(Machine *vm, int mode, int is_src, int *pc, Operand *op)
+{
+    const MemoryModel *mm = vm->mm;
+    int w;
+
+    op->mode = mode;
+    if (*pc >= LOGICAL_BASE + vm->code_size) return 0;
+    w = vm->mem[(*pc)++];
+    if (mode == ADDR_REGISTER) {
+        op->reg = is_src ? (w >> 6) & 0x7 : (w >> 2) & 0x7;
+        return 1;
+    }
+    if ((w & 0x3) == ARE_E) return -1;
+    if (mode == ADDR_IMMEDIATE) { op->value = field_sext(mm, w >> 2); return 1; }
+    op->value = w >> 2;
+    if (mode == ADDR_MATRIX) {
+        if (*pc >= LOGICAL_BASE + vm->code_size) return 0;
+        w = vm->mem[(*pc)++];
+        op->row = (w >> 6) & 0x7;
+        op->col = (w >> 2) & 0x7;
+    }
+    return 1;
+}
+
+/* decode_image — turn the code section into the Insn array, once */
+static int decode_image(const char *path, Machine *vm)
+{
+    int pc = LOGICAL_BASE, end = LOGICAL_BASE + vm->code_size, i;
+
+    vm->code = (Insn*)calloc((size_t)vm->code_size + 1, sizeof(Insn));
+    vm->at = (const Insn**)calloc((size_t)vm->code_size + 1, sizeof(Insn*));
+    vm->counts = (unsigned long*)calloc((size_t)vm->code_size + 1, sizeof(unsigned long));
+    if (!vm->code || !vm->at || !vm->counts) { fprintf(stderr, "[error] out of memory\n"); return 0; }
+
+    while (pc < end) {
+        Insn *in = &vm->code[vm->insn_count];
+        int w = vm->mem[pc], rc = 1;
+        int src_mode = (w >> 4) & 0x3, dst_mode = (w >> 2) & 0x3;
+
+        in->addr = pc;
+        in->opcode = (w >> 6) & 0xF;
+        in->fn = g_handlers[in->opcode];
+        in->src.mode = in->dst.mode = -1;
+        vm->at[pc - LOGICAL_BASE] = in;
+        pc++;
+
+        switch (in->opcode) {
+        case 0: case 1: case 2: case 3: case 6: /* two operands */
+            if (src_mode == ADDR_REGISTER && dst_mode == ADDR_REGISTER) {
+                int r = (pc < end) ? vm->mem[pc++] : 0;
+                in->src.mode = in->dst.mode = ADDR_REGISTER;
+                in->src.reg = (r >> 6) & 0x7;
+                in->dst.reg = (r >> 2) & 0x7;
+                break;
+            }
+            rc = decode_operand(vm, src_mode, 1, &pc, &in->src);
+            if (rc == 1) rc = decode_operand(vm, dst_mode, 0, &pc, &in->dst);
+            break;
+        case 14: case 15: /* no operands */
+            break;
+        default: /* one (destination) operand */
+            rc = decode_operand(vm, dst_mode, 0, &pc, &in->dst);
+            break;
+        }
+        if (rc == 0) { fprintf(stderr, "[error] %s: truncated instruction at %d\n", path, in->addr); return 0; }
+        if (rc < 0) {
+            fprintf(stderr, "[error] %s: unresolved external at %d (link the image first)\n", path, in->addr);
+            return 0;
+        }
+        in->size = pc - in->addr;
+        in->cost = in->size + (in->src.mode == ADDR_DIRECT || in->src.mode == ADDR_MATRIX)
+                            + (in->dst.mode == ADDR_DIRECT || in->dst.mode == ADDR_MATRIX);
+        vm->insn_count++;
+    }
+
+    /* pre-resolve direct jump targets to instruction pointers */
+    for (i = 0; i < vm->insn_count; ++i) {
+        Insn *in = &vm->code[i];
+        int idx = in->dst.value - LOGICAL_BASE;
+        if ((in->opcode == 9 || in->opcode == 10 || in->opcode == 13) && in->dst.mode == ADDR_DIRECT &&
+            idx >= 0 && idx < vm->code_size)
+            in->target = vm->at[idx];
+    }
+    /* falling off the end of the code halts like an implicit stop */
+    vm->code[vm->insn_count].fn = op_stop;
+    vm->code[vm->insn_count].addr = end;
+    return 1;
+}
+
+/* ---- running ------------------------------------------------------------ */
+
+/* run — dispatch loop with step/cycle budgets */
+static int run(Machine *vm)
+{
+    const Insn *ip = vm->insn_count ? vm->code : NULL;
+    unsigned long max_steps = g_opt.max_steps, max_cycles = g_opt.max_cycles;
+
+    while (ip) {
+        if ((max_steps && vm->steps >= max_steps) || (max_cycles && vm->cycles >= max_cycles))
+            return RUN_BUDGET;
+        vm->counts[ip - vm->code]++;
+        vm->steps++;
+        vm->cycles += (unsigned long)ip->cost;
+        ip = ip->fn(vm, ip);
+    }
+    return vm->fault ? RUN_FAULT : RUN_STOP;
+}
+
+/* print_counts — per-address execution counters (executed only) */
+static void print_counts(const Machine *vm, FILE *out)
+{
+    int i;
+    static const char *names[NUM_OPCODES] = {
+        "mov","cmp","add","sub","not","clr","lea","inc",
+        "dec","jmp","bne","red","prn","jsr","rts","stop"
+    };
+    for (i = 0; i < vm->insn_count; ++i) {
+        if (vm->counts[i])
+            fprintf(out, "%5d %-4s %lu\n", vm->code[i].addr, names[vm->code[i].opcode], vm->counts[i]);
+    }
+}
+
+/* simulate — load, decode and run one image; returns RUN_* */
+static int simulate(const char *path)
+{
+    Machine vm;
+    int rc;
+
+    memset(&vm, 0, sizeof(vm));
+    vm.mm = g_opt.mm;
+    vm.mem = (int*)calloc((size_t)vm.mm->mem_top, sizeof(int));
+    if (!vm.mem) { fprintf(stderr, "[error] out of memory\n"); return RUN_FAULT; }
+
+    if (!load_image(path, &vm) || !decode_image(path, &vm)) rc = RUN_FAULT;
+    else {
+        rc = run(&vm);
+        fflush(stdout);
+        if (rc == RUN_FAULT)
+            fprintf(stderr, "[fault] %s: %s at %d\n", path, vm.fault_msg, vm.fault_addr);
+        else if (rc == RUN_BUDGET)
+            fprintf(stderr, "[budget] %s: stopped after %lu steps / %lu cycles\n", path, vm.steps, vm.cycles);
+        fprintf(stderr, "[done] %s: %lu steps, %lu cycles\n", path, vm.steps, vm.cycles);
+        if (g_opt.show_counts) print_counts(&vm, stderr);
+    }
+
+    free(vm.mem); free(vm.code); free(vm.at); free(vm.counts);
+    return rc;
+}
+
+/* run_batch — one forked worker per image, at most g_opt.jobs at a time.
+ * Each worker reads <base>.in (or nothing) and writes <base>.out. */
+static int run_batch(char **paths, int n)
+{
+    int started = 0, running = 0, failed = 0;
+
+    while (started < n || running > 0) {
+        if (started < n && running < g_opt.jobs) {
+            pid_t pid = fork();
+            if (pid < 0) { perror("fork"); return 1; }
+            if (pid == 0) {
+                char base[512], io[520];
+                int fd;
+                if (!image_base(paths[started], base, sizeof(base))) _exit(RUN_FAULT);
+                sprintf(io, "%s.in", base);
+                fd = open(io, O_RDONLY);
+                if (fd < 0) fd = open("/dev/null", O_RDONLY);
+                if (fd >= 0) { dup2(fd, 0); close(fd); }
+                sprintf(io, "%s.out", base);
+                fd = open(io, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd >= 0) { dup2(fd, 1); close(fd); }
+                _exit(simulate(paths[started]));
+            }
+            started++;
+            running++;
+        } else {
+            int status;
+            if (wait(&status) > 0) {
+                running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != RUN_STOP) failed++;
+            }
+        }
+    }
+    fprintf(stderr, "[batch] %d image(s), %d failed\n", n, failed);
+    return failed ? 1 : 0;
+}
+
+/* main — simulator [options] image[.ob] [image ...] */
+int main(int argc, char **argv)
+{
+    char **paths;
+    int i, n = 0, rc = 0;
+
+    g_opt.mm = default_memory_model();
+    g_opt.max_steps = 10000000UL;
+    g_opt.max_cycles = 0;
+    g_opt.mat_cols = 2;
+    g_opt.jobs = 0;
+
+    paths = (char**)malloc((size_t)argc * sizeof(char*));
+    if (!paths) return 1;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            g_opt.mm = find_memory_model(argv[++i]);
+            if (!g_opt.mm) { fprintf(stderr, "[error] --model expects 'classic' or 'wide'\n"); return 1; }
+        } else if (strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+            g_opt.max_steps = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-cycles") == 0 && i + 1 < argc) {
+            g_opt.max_cycles = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mat-cols") == 0 && i + 1 < argc) {
+            g_opt.mat_cols = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--counts") == 0) {
+            g_opt.show_counts = 1;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            g_opt.jobs = atoi(argv[++i]);
+            if (g_opt.jobs <= 0) g_opt.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (g_opt.jobs <= 0) g_opt.jobs = 1;
+        } else {
+            paths[n++] = argv[i];
+        }
+    }
+    if (n == 0) {
+        printf("usage: %s [--model classic|wide] [--max-steps N] [--max-cycles N]\n"
+               "          [--mat-cols N] [--counts] [-j N] <image[.ob]> [image ...]\n", argv[0]);
+        free(paths);
+        return 0;
+    }
+
+    if (g_opt.jobs > 0) rc = run_batch(paths, n);
+    else {
+        for (i = 0; i < n; ++i) if (simulate(paths[i]) != RUN_STOP) rc = 1;
+    }
+    free(paths);
+    return rc;
+}
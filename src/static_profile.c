@@ -0,0 +1,111 @@
+/* static_profile.c
+ * Counts come from each statement's first word, where the encoder packed the
+ * opcode and both mode fields, so nothing is parsed again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "static_profile.h"
+
+static const char *const mode_names[5] = { "immediate", "direct", "matrix", "register", "none" };
+
+/* profile_reset — all zero */
+void profile_reset(StaticProfile *p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+/* profile_image — decode each statement's first word */
+void profile_image(StaticProfile *p, const MemoryImage *mem)
+{
+    int i;
+
+    p->files++;
+    p->code_words += mem->IC;
+    p->data_words += mem->DC;
+    p->fixups += mem->fixup_count;
+
+    for (i = 0; i < mem->stmt_count; ++i) {
+        const Statement *st = &mem->stmts[i];
+        const Instruction *in;
+        int word, src, dst;
+
+        if (st->words <= 0) continue;
+        word = mem->code[st->ic];
+        in = instruction_by_opcode((word >> 6) & 0xF);
+        if (!in) continue;
+        src = in->operands == 2 ? (word >> 4) & 0x3 : PROFILE_NO_OPERAND;
+        dst = in->operands >= 1 ? (word >> 2) & 0x3 : PROFILE_NO_OPERAND;
+
+        p->statements++;
+        p->opcodes[in->opcode]++;
+        p->pairs[src][dst]++;
+        if (src == ADDR_REGISTER && dst == ADDR_REGISTER) p->reg_reg_packed++;
+        if (src == ADDR_MATRIX) p->matrix_src++;
+        if (dst == ADDR_MATRIX) p->matrix_dst++;
+    }
+}
+
+/* write_text — the human-readable report */
+static void write_text(FILE *out, const StaticProfile *p)
+{
+    int i, s, d;
+
+    fprintf(out, "static profile: %d file(s), %d statement(s)\n", p->files, p->statements);
+    fprintf(out, "  code words        %8d\n", p->code_words);
+    fprintf(out, "  data words        %8d\n", p->data_words);
+    fprintf(out, "  fixups            %8d  (%.3f per code word)\n", p->fixups,
+            p->code_words ? (double)p->fixups / p->code_words : 0.0);
+    fprintf(out, "  reg-reg packed    %8d  (words saved)\n", p->reg_reg_packed);
+    fprintf(out, "  matrix operands   %8d  (src %d, dst %d)\n",
+            p->matrix_src + p->matrix_dst, p->matrix_src, p->matrix_dst);
+
+    fprintf(out, "opcode        count\n");
+    for (i = 0; i < NUM_OPCODES; ++i) {
+        const Instruction *in = instruction_by_opcode(i);
+        if (p->opcodes[i]) fprintf(out, "  %-6s   %8d\n", in->name, p->opcodes[i]);
+    }
+
+    fprintf(out, "src        dst           count\n");
+    for (s = 0; s < 5; ++s)
+        for (d = 0; d < 5; ++d)
+            if (p->pairs[s][d])
+                fprintf(out, "  %-9s %-9s %8d\n", mode_names[s], mode_names[d], p->pairs[s][d]);
+}
+
+/* write_json — same counters as one object; zero entries are left out */
+static void write_json(FILE *out, const StaticProfile *p)
+{
+    int i, s, d, first = 1;
+
+    fprintf(out, "{\"files\": %d, \"statements\": %d, \"code_words\": %d, \"data_words\": %d,\n",
+            p->files, p->statements, p->code_words, p->data_words);
+    fprintf(out, " \"fixups\": %d, \"fixups_per_code_word\": %.4f, \"reg_reg_packed\": %d,\n",
+            p->fixups, p->code_words ? (double)p->fixups / p->code_words : 0.0, p->reg_reg_packed);
+    fprintf(out, " \"matrix_operands\": {\"src\": %d, \"dst\": %d},\n", p->matrix_src, p->matrix_dst);
+
+    fprintf(out, " \"opcodes\": {");
+    for (i = 0; i < NUM_OPCODES; ++i) {
+        if (!p->opcodes[i]) continue;
+        fprintf(out, "%s\"%s\": %d", first ? "" : ", ", instruction_by_opcode(i)->name, p->opcodes[i]);
+        first = 0;
+    }
+    fprintf(out, "},\n \"mode_pairs\": [");
+    first = 1;
+    for (s = 0; s < 5; ++s)
+        for (d = 0; d < 5; ++d) {
+            if (!p->pairs[s][d]) continue;
+            fprintf(out, "%s\n  {\"src\": \"%s\", \"dst\": \"%s\", \"count\": %d}", first ? "" : ",",
+                    mode_names[s], mode_names[d], p->pairs[s][d]);
+            first = 0;
+        }
+    fprintf(out, "%s]}\n", first ? "" : "\n ");
+}
+
+/* write_profile — text or JSON */
+void write_profile(FILE *out, const StaticProfile *p, int json)
+{
+    if (json) write_json(out, p);
+    else write_text(out, p);
+}
@@ -0,0 +1,108 @@
+/* string_pool.c
+ * Tail merging of .string literals. Literals are sorted by their words read
+ * backwards, so a literal that ends another sorts right before it; one walk
+ * down the sorted list then finds the copy every literal can share.
+ */
+
+#include <stdlib.h>
+
+#include "string_pool.h"
+#include "alloc_stats.h"
+
+static int g_pool_strings = 0;
+static const Word *g_sort_data;        /* qsort has no context argument */
+
+/* set_pool_strings — used by first_pass */
+void set_pool_strings(int on)
+{
+    g_pool_strings = on ? 1 : 0;
+}
+
+/* pool_strings_enabled — current setting */
+int pool_strings_enabled(void)
+{
+    return g_pool_strings;
+}
+
+/* cmp_tail — backwards word order, shorter first; equal literals put the
+ * earliest copy last, so it is the one the others share */
+static int cmp_tail(const void *a, const void *b)
+{
+    const DataSpan *x = *(const DataSpan *const *)a;
+    const DataSpan *y = *(const DataSpan *const *)b;
+    const Word *ex = g_sort_data + x->dc + x->words, *ey = g_sort_data + y->dc + y->words;
+    int i, n = x->words < y->words ? x->words : y->words;
+
+    for (i = 1; i <= n; ++i)
+        if (ex[-i] != ey[-i]) return ex[-i] < ey[-i] ? -1 : 1;
+    if (x->words != y->words) return x->words < y->words ? -1 : 1;
+    return y->dc - x->dc;
+}
+
+/* ends_with — literal b's words end with all of literal a's */
+static int ends_with(const Word *data, const DataSpan *b, const DataSpan *a)
+{
+    int i;
+    if (a->words > b->words) return 0;
+    for (i = 1; i <= a->words; ++i)
+        if (data[a->dc + a->words - i] != data[b->dc + b->words - i]) return 0;
+    return 1;
+}
+
+/* pool_strings — share literals, compact data[], remap labels and spans */
+int pool_strings(MemoryImage *mem, Symbol *symbols)
+{
+    DataSpan **strs, **host;
+    int *map;
+    int i, k, n = 0, w, dc = mem->DC;
+    Symbol *s;
+
+    for (i = 0; i < mem->span_count; ++i) if (mem->spans[i].string) ++n;
+    if (n < 2) return 0;
+
+    strs = (DataSpan **)as_malloc((size_t)n * sizeof(DataSpan *));
+    host = (DataSpan **)as_malloc((size_t)n * sizeof(DataSpan *));
+    map = (int *)as_malloc((size_t)(dc + 1) * sizeof(int));
+    if (!strs || !host || !map) {
+        as_free(strs); as_free(host); as_free(map);
+        return 0;
+    }
+
+    for (i = 0, k = 0; i < mem->span_count; ++i)
+        if (mem->spans[i].string) strs[k++] = &mem->spans[i];
+    g_sort_data = mem->data;
+    qsort(strs, (size_t)n, sizeof(DataSpan *), cmp_tail);
+
+    /* a literal ending the next one shares that one's host */
+    host[n - 1] = strs[n - 1];
+    for (i = n - 2; i >= 0; --i)
+        host[i] = ends_with(mem->data, strs[i + 1], strs[i]) ? host[i + 1] : strs[i];
+
+    /* new slot of every word that stays; shared literals' words are -1 */
+    for (k = 0; k < dc; ++k) map[k] = 0;
+    for (i = 0; i < n; ++i)
+        if (host[i] != strs[i])
+            for (k = 0; k < strs[i]->words; ++k) map[strs[i]->dc + k] = -1;
+    for (k = 0, w = 0; k < dc; ++k) if (map[k] == 0) map[k] = w++;
+    map[dc] = w;
+
+    /* compact: kept words only move down */
+    for (k = 0; k < dc; ++k) if (map[k] >= 0) mem->data[map[k]] = mem->data[k];
+    mem->DC = w;
+
+    /* shared words map into the tail of their host */
+    for (i = 0; i < n; ++i)
+        if (host[i] != strs[i]) {
+            int at = map[host[i]->dc] + host[i]->words - strs[i]->words;
+            for (k = 0; k < strs[i]->words; ++k) map[strs[i]->dc + k] = at + k;
+        }
+
+    for (i = 0; i < mem->span_count; ++i) mem->spans[i].dc = map[mem->spans[i].dc];
+
+    for (s = symbols; s; s = s->next)
+        if (s->type == SYMBOL_DATA && !s->is_extern && s->address >= 0 && s->address <= dc)
+            s->address = map[s->address];
+
+    as_free(strs); as_free(host); as_free(map);
+    return dc - w;
+}
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "symbol_table.h"
+#include "alloc_stats.h"
 
 /* init_symbol_table — initialize table to empty */
 void init_symbol_table(Symbol **head) {
@@ -16,7 +17,7 @@ void init_symbol_table(Symbol **head) {
 /* add_symbol — append a new symbol to the table */
 int add_symbol(Symbol **head, const char *name, int address, SymbolType type)
 {
-    Symbol *new_symbol = (Symbol *)malloc(sizeof(Symbol));
+    Symbol *new_symbol = (Symbol *)as_malloc(sizeof(Symbol));
     Symbol *current;
 
     if (!new_symbol)
@@ -27,6 +28,8 @@ int add_symbol(Symbol **head, const char *name, int address, SymbolType type)
     new_symbol->type = type;
     new_symbol->is_entry = 0;
     new_symbol->is_extern = 0;
+    new_symbol->line = 0;
+    new_symbol->id = 0;
     new_symbol->next = NULL;
 
     if (*head == NULL) {
@@ -37,6 +40,7 @@ int add_symbol(Symbol **head, const char *name, int address, SymbolType type)
     current = *head;
     while (current->next)
         current = current->next;
+    new_symbol->id = current->id + 1;
     current->next = new_symbol;
 
     return 1;
@@ -53,6 +57,21 @@ Symbol *find_symbol(Symbol *head, const char *name)
     return NULL;
 }
 
+/* index_symbols — ids are list positions, so one walk fills the array */
+Symbol **index_symbols(Symbol *head, int *count)
+{
+    Symbol **by_id, *s;
+    int n = 0;
+
+    for (s = head; s; s = s->next) n++;
+    *count = n;
+    if (n == 0) return NULL;
+    by_id = (Symbol **)as_malloc((size_t)n * sizeof(Symbol *));
+    if (!by_id) return NULL;
+    for (s = head; s; s = s->next) by_id[s->id] = s;
+    return by_id;
+}
+
 /* print_symbol_table — debug print of all symbols */
 void print_symbol_table(Symbol *head)
 {
@@ -72,7 +91,7 @@ void free_symbol_table(Symbol **head)
     while (curr) {
         Symbol *temp = curr;
         curr = curr->next;
-        free(temp);
+        as_free(temp);
     }
     *head = NULL;
 }
@@ -0,0 +1,545 @@
+/* symdb.c
+ * Project symbol database: one memory-mappable index over every .ent/.ext
+ * file under some directories, mapping each symbol to the modules that
+ * export it and the modules that use it. "build" re-reads only the files
+ * whose size or mtime changed since the last index; "query" answers with a
+ * single hash probe into the mapped file.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "memory_image.h"
+#include "object_reader.h"
+#include "alloc_stats.h"
+
+#define SYMDB_MAGIC   "SYMDB01"
+#define DEFAULT_INDEX "symdb.idx"
+
+/* ---- on-disk layout ------------------------------------------------------
+ * DbHeader, then files[], modules[], refs[], syms[], links[], buckets[] and
+ * the string table. Every field is a native unsigned int, so the sections
+ * stay aligned and are used in place; the index is a local cache, not an
+ * interchange format. */
+
+typedef struct {
+    char magic[8];
+    unsigned int addr_digits;         /* model the refs were parsed with */
+    unsigned int built;               /* time the file scan started */
+    unsigned int file_count, module_count, ref_count;
+    unsigned int sym_count, link_count, bucket_count, str_size;
+} DbHeader;
+
+/* DbFile — one .ent/.ext file and the refs read from it */
+typedef struct {
+    unsigned int path;                /* string offset */
+    unsigned int module;
+    unsigned int size, mtime;         /* fingerprint for incremental builds */
+    unsigned int is_ext;
+    unsigned int first_ref, ref_count;
+} DbFile;
+
+/* DbRef — one line of a file */
+typedef struct {
+    unsigned int sym, address;
+} DbRef;
+
+/* DbSym — a symbol and its export/use lists in links[] */
+typedef struct {
+    unsigned int name, hash;
+    unsigned int first_def, def_count;
+    unsigned int first_use, use_count;
+} DbSym;
+
+/* DbLink — one module that exports or uses a symbol */
+typedef struct {
+    unsigned int module, address;
+} DbLink;
+
+/* Db — a mapped index with its sections located */
+typedef struct {
+    const DbHeader *h;
+    const DbFile *files;
+    const unsigned int *modules;
+    const DbRef *refs;
+    const DbSym *syms;
+    const DbLink *links;
+    const unsigned int *buckets;      /* symbol index + 1; 0 = empty */
+    const char *str;
+    size_t len;
+} Db;
+
+/* ---- small helpers ------------------------------------------------------ */
+
+/* xmalloc_or_die — allocation that aborts on failure */
+static void *xmalloc_or_die(size_t n)
+{
+    void *p = as_malloc(n ? n : 1);
+    if (!p) { fprintf(stderr, "[error] symdb: out of memory\n"); exit(1); }
+    return p;
+}
+
+/* xrealloc_or_die — grow a block from xmalloc_or_die */
+static void *xrealloc_or_die(void *p, size_t n)
+{
+    p = as_realloc(p, n ? n : 1);
+    if (!p) { fprintf(stderr, "[error] symdb: out of memory\n"); exit(1); }
+    return p;
+}
+
+/* hash_name — FNV-1a */
+static unsigned hash_name(const char *s)
+{
+    unsigned h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+/* ---- opening an index --------------------------------------------------- */
+
+/* db_open — map path and check that every section fits; 0 if absent/invalid */
+static int db_open(const char *path, Db *db)
+{
+    struct stat st;
+    const DbHeader *h;
+    size_t need;
+    int fd = open(path, O_RDONLY);
+    void *p;
+
+    memset(db, 0, sizeof(*db));
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DbHeader)) { close(fd); return 0; }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return 0;
+
+    h = (const DbHeader *)p;
+    need = sizeof(DbHeader) + h->file_count * sizeof(DbFile) + h->module_count * sizeof(unsigned int)
+         + h->ref_count * sizeof(DbRef) + h->sym_count * sizeof(DbSym) + h->link_count * sizeof(DbLink)
+         + h->bucket_count * sizeof(unsigned int) + h->str_size;
+    if (memcmp(h->magic, SYMDB_MAGIC, 8) != 0 || need != (size_t)st.st_size ||
+        (h->bucket_count & (h->bucket_count - 1)) != 0 || h->bucket_count <= h->sym_count) {
+        munmap(p, (size_t)st.st_size);
+        return 0;
+    }
+    db->h = h;
+    db->len = (size_t)st.st_size;
+    db->files = (const DbFile *)(h + 1);
+    db->modules = (const unsigned int *)(db->files + h->file_count);
+    db->refs = (const DbRef *)(db->modules + h->module_count);
+    db->syms = (const DbSym *)(db->refs + h->ref_count);
+    db->links = (const DbLink *)(db->syms + h->sym_count);
+    db->buckets = (const unsigned int *)(db->links + h->link_count);
+    db->str = (const char *)(db->buckets + h->bucket_count);
+    return 1;
+}
+
+/* db_close — unmap */
+static void db_close(Db *db)
+{
+    if (db->h) munmap((void *)db->h, db->len);
+    db->h = NULL;
+}
+
+/* db_find — symbol index by name, or -1 */
+static int db_find(const Db *db, const char *name)
+{
+    unsigned h = hash_name(name), mask = db->h->bucket_count - 1, i;
+    for (i = h & mask; db->buckets[i]; i = (i + 1) & mask) {
+        const DbSym *s = &db->syms[db->buckets[i] - 1];
+        if (s->hash == h && strcmp(db->str + s->name, name) == 0) return (int)(db->buckets[i] - 1);
+    }
+    return -1;
+}
+
+/* db_find_file — old file record by path (files are sorted by path), or NULL */
+static const DbFile *db_find_file(const Db *db, const char *path)
+{
+    int lo = 0, hi = db->h ? (int)db->h->file_count - 1 : -1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = strcmp(path, db->str + db->files[mid].path);
+        if (c == 0) return &db->files[mid];
+        if (c < 0) hi = mid - 1; else lo = mid + 1;
+    }
+    return NULL;
+}
+
+/* ---- building ----------------------------------------------------------- */
+
+/* StrTab — growing string table */
+typedef struct {
+    char *data;
+    unsigned int len, cap;
+} StrTab;
+
+/* str_add — append s (with its NUL); its offset */
+static unsigned int str_add(StrTab *t, const char *s, size_t n)
+{
+    unsigned int off = t->len;
+    while (t->len + n + 1 > t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 4096;
+        t->data = (char *)xrealloc_or_die(t->data, t->cap);
+    }
+    memcpy(t->data + t->len, s, n);
+    t->data[t->len + n] = '\0';
+    t->len += (unsigned int)n + 1;
+    return off;
+}
+
+/* Intern — strings kept once, found by open addressing */
+typedef struct {
+    unsigned int *off, *hash;         /* per entry */
+    int count, cap;
+    unsigned int *slots;              /* entry + 1; 0 = empty */
+    unsigned int mask;
+} Intern;
+
+/* intern_grow — double the slot table and rehash */
+static void intern_grow(Intern *t)
+{
+    unsigned int size = t->slots ? (t->mask + 1) * 2 : 1024, i;
+    as_free(t->slots);
+    t->slots = (unsigned int *)xmalloc_or_die(size * sizeof(unsigned int));
+    memset(t->slots, 0, size * sizeof(unsigned int));
+    t->mask = size - 1;
+    for (i = 0; i < (unsigned int)t->count; ++i) {
+        unsigned int k = t->hash[i] & t->mask;
+        while (t->slots[k]) k = (k + 1) & t->mask;
+        t->slots[k] = i + 1;
+    }
+}
+
+/* intern — entry index for s[0..n), added to str if new */
+static int intern(Intern *t, StrTab *str, const char *s, size_t n)
+{
+    unsigned int h = 2166136261u, k;
+    size_t i;
+    for (i = 0; i < n; ++i) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+
+    if (!t->slots || 2 * (t->count + 1) > (int)(t->mask + 1)) intern_grow(t);
+    for (k = h & t->mask; t->slots[k]; k = (k + 1) & t->mask) {
+        unsigned int e = t->slots[k] - 1;
+        const char *have = str->data + t->off[e];
+        if (t->hash[e] == h && strncmp(have, s, n) == 0 && have[n] == '\0') return (int)e;
+    }
+    if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 256;
+        t->off = (unsigned int *)xrealloc_or_die(t->off, (size_t)t->cap * sizeof(unsigned int));
+        t->hash = (unsigned int *)xrealloc_or_die(t->hash, (size_t)t->cap * sizeof(unsigned int));
+    }
+    t->off[t->count] = str_add(str, s, n);
+    t->hash[t->count] = h;
+    t->slots[k] = (unsigned int)t->count + 1;
+    return t->count++;
+}
+
+/* intern_free — release the tables (strings live in the StrTab) */
+static void intern_free(Intern *t)
+{
+    as_free(t->off); as_free(t->hash); as_free(t->slots);
+}
+
+/* PathList — .ent/.ext paths found under the roots */
+typedef struct {
+    char **path;
+    int count, cap;
+} PathList;
+
+/* is_ref_file — name ends in .ent or .ext */
+static int is_ref_file(const char *name)
+{
+    size_t n = strlen(name);
+    return n > 4 && (strcmp(name + n - 4, ".ent") == 0 || strcmp(name + n - 4, ".ext") == 0);
+}
+
+/* walk — collect ref files under dir (recursive; dot entries skipped) */
+static void walk(const char *dir, PathList *out)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    if (!d) { fprintf(stderr, "[error] symdb: cannot read directory %s\n", dir); return; }
+    while ((e = readdir(d)) != NULL) {
+        struct stat st;
+        size_t n = strlen(dir) + strlen(e->d_name) + 2;
+        char *path;
+        if (e->d_name[0] == '.') continue;
+        path = (char *)xmalloc_or_die(n);
+        sprintf(path, "%s/%s", dir, e->d_name);
+        if (stat(path, &st) != 0) { as_free(path); continue; }
+        if (S_ISDIR(st.st_mode)) {
+            walk(path, out);
+            as_free(path);
+        } else if (S_ISREG(st.st_mode) && is_ref_file(e->d_name)) {
+            if (out->count == out->cap) {
+                out->cap = out->cap ? out->cap * 2 : 256;
+                out->path = (char **)xrealloc_or_die(out->path, (size_t)out->cap * sizeof(char *));
+            }
+            out->path[out->count++] = path;
+        } else {
+            as_free(path);
+        }
+    }
+    closedir(d);
+}
+
+/* cmp_path — qsort by path */
+static int cmp_path(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* write_all — fwrite that remembers failure */
+static void write_all(FILE *fp, const void *p, size_t n, int *ok)
+{
+    if (n && fwrite(p, 1, n, fp) != n) *ok = 0;
+}
+
+/* build — (re)index every ref file under roots into index_path */
+static int build(const char *index_path, char **roots, int nroots, const MemoryModel *mm)
+{
+    PathList pl = { NULL, 0, 0 };
+    Db old;
+    StrTab str = { NULL, 0, 0 };
+    Intern syms, mods;
+    DbFile *files;
+    DbRef *refs = NULL;
+    DbSym *out_syms;
+    DbLink *links;
+    unsigned int *buckets, nbuckets = 16, nrefs = 0, ref_cap = 0, nlinks = 0;
+    int i, nfiles = 0, reread = 0, ok = 1;
+    DbHeader h;
+    char tmp[600];
+    FILE *fp;
+
+    memset(&syms, 0, sizeof(syms));
+    memset(&mods, 0, sizeof(mods));
+    memset(&h, 0, sizeof(h));
+    h.built = (unsigned int)time(NULL);
+    for (i = 0; i < nroots; ++i) {
+        size_t n = strlen(roots[i]);
+        while (n > 1 && roots[i][n - 1] == '/') roots[i][--n] = '\0';
+        walk(roots[i], &pl);
+    }
+    qsort(pl.path, (size_t)pl.count, sizeof(char *), cmp_path);
+
+    /* an index built for another model is not reused */
+    if (db_open(index_path, &old) && old.h->addr_digits != (unsigned int)mm->addr_digits) db_close(&old);
+
+    files = (DbFile *)xmalloc_or_die((size_t)pl.count * sizeof(DbFile));
+    for (i = 0; i < pl.count; ++i) {
+        const char *path = pl.path[i];
+        const DbFile *was = old.h ? db_find_file(&old, path) : NULL;
+        DbFile *f = &files[nfiles];
+        struct stat st;
+        unsigned int k;
+
+        if (stat(path, &st) != 0) continue;    /* removed since the walk: not indexed */
+        nfiles++;
+        f->path = str_add(&str, path, strlen(path));
+        f->module = (unsigned int)intern(&mods, &str, path, strlen(path) - 4);
+        f->size = (unsigned int)st.st_size;
+        f->mtime = (unsigned int)st.st_mtime;
+        f->is_ext = strcmp(path + strlen(path) - 4, ".ext") == 0;
+        f->first_ref = nrefs;
+
+        /* unchanged: take its refs from the old index. A file touched in the
+         * second the old build ran may have changed after it was read, and
+         * one that failed to parse has no fingerprint (mtime 0). */
+        if (was && was->mtime != 0 && was->size == f->size && was->mtime == f->mtime &&
+            was->mtime < old.h->built) {
+            f->ref_count = was->ref_count;
+            if (nrefs + was->ref_count > ref_cap) {
+                while (nrefs + was->ref_count > ref_cap) ref_cap = ref_cap ? ref_cap * 2 : 1024;
+                refs = (DbRef *)xrealloc_or_die(refs, ref_cap * sizeof(DbRef));
+            }
+            for (k = 0; k < was->ref_count; ++k) {
+                const DbRef *r = &old.refs[was->first_ref + k];
+                const char *name = old.str + old.syms[r->sym].name;
+                refs[nrefs].sym = (unsigned int)intern(&syms, &str, name, strlen(name));
+                refs[nrefs++].address = r->address;
+            }
+        } else {
+            ObjRef *rd;
+            int n, j;
+            if (!read_object_refs(path, mm, &rd, &n)) {
+                f->size = f->mtime = 0;           /* re-read (and re-reported) next time */
+                ok = 0;
+            }
+            reread++;
+            f->ref_count = (unsigned int)n;
+            if (nrefs + (unsigned int)n > ref_cap) {
+                while (nrefs + (unsigned int)n > ref_cap) ref_cap = ref_cap ? ref_cap * 2 : 1024;
+                refs = (DbRef *)xrealloc_or_die(refs, ref_cap * sizeof(DbRef));
+            }
+            for (j = 0; j < n; ++j) {
+                refs[nrefs].sym = (unsigned int)intern(&syms, &str, rd[j].name, strlen(rd[j].name));
+                refs[nrefs++].address = (unsigned int)rd[j].address;
+            }
+            as_free(rd);
+        }
+    }
+    db_close(&old);
+
+    /* per-symbol export and use lists, in file (path) order */
+    out_syms = (DbSym *)xmalloc_or_die((size_t)syms.count * sizeof(DbSym));
+    memset(out_syms, 0, (size_t)syms.count * sizeof(DbSym));
+    for (i = 0; i < nfiles; ++i) {
+        unsigned int k;
+        for (k = 0; k < files[i].ref_count; ++k) {
+            DbSym *s = &out_syms[refs[files[i].first_ref + k].sym];
+            if (files[i].is_ext) s->use_count++; else s->def_count++;
+        }
+    }
+    for (i = 0; i < syms.count; ++i) {
+        DbSym *s = &out_syms[i];
+        s->name = syms.off[i];
+        s->hash = syms.hash[i];
+        s->first_def = nlinks; nlinks += s->def_count;
+        s->first_use = nlinks; nlinks += s->use_count;
+        s->def_count = s->use_count = 0;
+    }
+    links = (DbLink *)xmalloc_or_die((size_t)nlinks * sizeof(DbLink));
+    for (i = 0; i < nfiles; ++i) {
+        unsigned int k;
+        for (k = 0; k < files[i].ref_count; ++k) {
+            const DbRef *r = &refs[files[i].first_ref + k];
+            DbSym *s = &out_syms[r->sym];
+            DbLink *l = files[i].is_ext ? &links[s->first_use + s->use_count++]
+                                        : &links[s->first_def + s->def_count++];
+            l->module = files[i].module;
+            l->address = r->address;
+        }
+    }
+
+    while (nbuckets <= 2 * (unsigned int)syms.count) nbuckets <<= 1;
+    buckets = (unsigned int *)xmalloc_or_die(nbuckets * sizeof(unsigned int));
+    memset(buckets, 0, nbuckets * sizeof(unsigned int));
+    for (i = 0; i < syms.count; ++i) {
+        unsigned int k = out_syms[i].hash & (nbuckets - 1);
+        while (buckets[k]) k = (k + 1) & (nbuckets - 1);
+        buckets[k] = (unsigned int)i + 1;
+    }
+
+    /* write next to the index and rename, so readers never see half a file */
+    memcpy(h.magic, SYMDB_MAGIC, 8);
+    h.addr_digits = (unsigned int)mm->addr_digits;
+    h.file_count = (unsigned int)nfiles;
+    h.module_count = (unsigned int)mods.count;
+    h.ref_count = nrefs;
+    h.sym_count = (unsigned int)syms.count;
+    h.link_count = nlinks;
+    h.bucket_count = nbuckets;
+    h.str_size = str.len;
+    sprintf(tmp, "%.590s.tmp", index_path);
+    fp = fopen(tmp, "wb");
+    if (!fp) {
+        fprintf(stderr, "[error] symdb: cannot write %s\n", tmp);
+        ok = 0;
+    } else {
+        int wok = 1;
+        write_all(fp, &h, sizeof(h), &wok);
+        write_all(fp, files, (size_t)nfiles * sizeof(DbFile), &wok);
+        write_all(fp, mods.off, (size_t)mods.count * sizeof(unsigned int), &wok);
+        write_all(fp, refs, nrefs * sizeof(DbRef), &wok);
+        write_all(fp, out_syms, (size_t)syms.count * sizeof(DbSym), &wok);
+        write_all(fp, links, nlinks * sizeof(DbLink), &wok);
+        write_all(fp, buckets, nbuckets * sizeof(unsigned int), &wok);
+        write_all(fp, str.data, str.len, &wok);
+        if (fclose(fp) != 0) wok = 0;
+        if (!wok || rename(tmp, index_path) != 0) {
+            fprintf(stderr, "[error] symdb: cannot write %s\n", index_path);
+            remove(tmp);
+            ok = 0;
+        } else {
+            printf("[symdb] %s: %d file(s), %d re-read, %d module(s), %d symbol(s)\n",
+                   index_path, nfiles, reread, mods.count, syms.count);
+        }
+    }
+
+    for (i = 0; i < pl.count; ++i) as_free(pl.path[i]);
+    as_free(pl.path);
+    as_free(files); as_free(refs); as_free(out_syms); as_free(links); as_free(buckets);
+    intern_free(&syms); intern_free(&mods);
+    as_free(str.data);
+    return ok;
+}
+
+/* ---- queries ------------------------------------------------------------ */
+
+/* print_links — one "  <kind>  <module>  <address>" row per link */
+static void print_links(const Db *db, const char *kind, unsigned int first, unsigned int count)
+{
+    unsigned int k;
+    for (k = 0; k < count; ++k) {
+        const DbLink *l = &db->links[first + k];
+        printf("  %-6s  %s  %u\n", kind, db->str + db->modules[l->module], l->address);
+    }
+}
+
+/* query — exporters and users of each name; 0 if any is unknown */
+static int query(const char *index_path, char **names, int n)
+{
+    Db db;
+    int i, ok = 1;
+
+    if (!db_open(index_path, &db)) {
+        fprintf(stderr, "[error] symdb: %s is missing or not an index (run 'symdb build')\n", index_path);
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        int s = db_find(&db, names[i]);
+        if (s < 0) {
+            printf("%s: not found\n", names[i]);
+            ok = 0;
+            continue;
+        }
+        printf("%s\n", names[i]);
+        print_links(&db, "export", db.syms[s].first_def, db.syms[s].def_count);
+        print_links(&db, "use", db.syms[s].first_use, db.syms[s].use_count);
+    }
+    db_close(&db);
+    return ok;
+}
+
+/* main — symdb build [--model M] [-o index] dir...  |  symdb query [-i index] name... */
+int main(int argc, char **argv)
+{
+    const MemoryModel *mm = default_memory_model();
+    const char *index_path = DEFAULT_INDEX;
+    char **args;
+    int i, n = 0, ok;
+
+    if (argc < 3 || (strcmp(argv[1], "build") != 0 && strcmp(argv[1], "query") != 0)) {
+        printf("usage: %s build [--model classic|wide] [-o index] <dir> [dir ...]\n"
+               "       %s query [-i index] <symbol> [symbol ...]\n", argv[0], argv[0]);
+        return argc < 2 ? 0 : 1;
+    }
+
+    args = (char **)xmalloc_or_die((size_t)argc * sizeof(char *));
+    for (i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            mm = find_memory_model(argv[++i]);
+            if (!mm) { fprintf(stderr, "[error] --model expects 'classic' or 'wide'\n"); return 1; }
+            continue;
+        }
+        if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-i") == 0) && i + 1 < argc) {
+            index_path = argv[++i];
+            continue;
+        }
+        args[n++] = argv[i];
+    }
+
+    if (argv[1][0] == 'b') ok = build(index_path, args, n, mm);
+    else ok = query(index_path, args, n);
+    as_free(args);
+    return ok ? 0 : 1;
+}
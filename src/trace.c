@@ -0,0 +1,170 @@
+/* trace.c
+ * Per-thread event rings for the trace points. A thread finds its ring
+ * through a pthread key; when it exits the ring goes to a free list and the
+ * next new thread continues it, so short-lived pass workers reuse lanes.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+/* trace_compiled_in — lets the CLI reject --trace in normal builds */
+int trace_compiled_in(void)
+{
+#ifdef ASM_TRACE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef ASM_TRACE
+
+/* TraceEvent — one begin or end mark */
+typedef struct {
+    const char *name;                 /* string literal at the trace point */
+    double ts;                        /* microseconds since trace_start */
+    char ph;
+    char arg[TRACE_ARG_LEN];          /* e.g. the source file; "" if none */
+} TraceEvent;
+
+/* TraceRing — one lane of the timeline */
+typedef struct TraceRing {
+    TraceEvent ev[TRACE_RING_EVENTS];
+    unsigned long count;              /* events ever recorded */
+    int tid;
+    int idle;                         /* its thread has exited */
+    struct TraceRing *next;
+} TraceRing;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_key;
+static TraceRing *g_rings = NULL;     /* every ring, newest first */
+static int g_ring_count = 0;
+static int g_on = 0;
+static struct timespec g_t0;
+
+/* release_ring — thread exit: the ring can be taken over */
+static void release_ring(void *p)
+{
+    pthread_mutex_lock(&g_lock);
+    ((TraceRing *)p)->idle = 1;
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void make_key(void) { (void)pthread_key_create(&g_key, release_ring); }
+
+/* this_ring — the calling thread's ring (an idle one, or a new one) */
+static TraceRing *this_ring(void)
+{
+    TraceRing *r = (TraceRing *)pthread_getspecific(g_key);
+    if (r) return r;
+
+    pthread_mutex_lock(&g_lock);
+    for (r = g_rings; r && !r->idle; r = r->next) ;
+    if (r) {
+        r->idle = 0;
+    } else if ((r = (TraceRing *)malloc(sizeof(TraceRing))) != NULL) {
+        r->count = 0;
+        r->tid = ++g_ring_count;
+        r->idle = 0;
+        r->next = g_rings;
+        g_rings = r;
+    }
+    pthread_mutex_unlock(&g_lock);
+    if (r) pthread_setspecific(g_key, r);
+    return r;
+}
+
+/* trace_start — reset the clock and every ring */
+void trace_start(void)
+{
+    TraceRing *r;
+    pthread_once(&g_once, make_key);
+    pthread_mutex_lock(&g_lock);
+    for (r = g_rings; r; r = r->next) r->count = 0;
+    pthread_mutex_unlock(&g_lock);
+    clock_gettime(CLOCK_MONOTONIC, &g_t0);
+    g_on = 1;
+}
+
+/* trace_event — append to this thread's ring */
+void trace_event(const char *name, char ph, const char *arg)
+{
+    struct timespec now;
+    TraceRing *r;
+    TraceEvent *e;
+
+    if (!g_on || (r = this_ring()) == NULL) return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    e = &r->ev[r->count++ % TRACE_RING_EVENTS];
+    e->name = name;
+    e->ph = ph;
+    e->ts = (double)(now.tv_sec - g_t0.tv_sec) * 1e6 + (double)(now.tv_nsec - g_t0.tv_nsec) / 1e3;
+    e->arg[0] = '\0';
+    if (arg) {
+        strncpy(e->arg, arg, TRACE_ARG_LEN - 1);
+        e->arg[TRACE_ARG_LEN - 1] = '\0';
+    }
+}
+
+/* put_json_string — quoted, with the characters JSON needs escaped */
+static void put_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(out, "\\u%04x", (unsigned)(unsigned char)*s);
+        else fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/* trace_dump — every ring, each from its oldest kept event */
+int trace_dump(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    TraceRing *r;
+    int first = 1;
+    long pid = (long)getpid();
+
+    if (!out) return 0;
+    pthread_mutex_lock(&g_lock);
+    fprintf(out, "{\"traceEvents\": [");
+    for (r = g_rings; r; r = r->next) {
+        unsigned long k = r->count > TRACE_RING_EVENTS ? r->count - TRACE_RING_EVENTS : 0;
+        for (; k < r->count; ++k) {
+            const TraceEvent *e = &r->ev[k % TRACE_RING_EVENTS];
+            fprintf(out, "%s\n{\"name\": ", first ? "" : ",");
+            put_json_string(out, e->name);
+            fprintf(out, ", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": %ld, \"tid\": %d",
+                    e->ph, e->ts, pid, r->tid);
+            if (e->arg[0]) {
+                fprintf(out, ", \"args\": {\"file\": ");
+                put_json_string(out, e->arg);
+                fputc('}', out);
+            }
+            fputc('}', out);
+            first = 0;
+        }
+    }
+    fprintf(out, "\n], \"displayTimeUnit\": \"ms\"}\n");
+    pthread_mutex_unlock(&g_lock);
+    return fclose(out) == 0;
+}
+
+#else
+
+/* without ASM_TRACE there is nothing to record or write */
+void trace_start(void) {}
+int trace_dump(const char *path) { (void)path; return 0; }
+
+#endif /* ASM_TRACE */
@@ -0,0 +1,256 @@
+/* watch.c
+ * --watch mode: inotify on the directories of each source and of the files
+ * it .includes, debounced. A source whose contents hash the same is skipped
+ * unless one of its includes changed; the rest are reassembled,
+ * incrementally when the edit allows it.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "watch.h"
+#include "assemble.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "error_list.h"
+#include "string_pool.h"
+#include "incremental.h"
+#include "output_files.h"
+#include "pre_assembler.h"
+
+#define WATCH_DEBOUNCE_MS 100         /* quiet time that ends a burst of writes */
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+/* WatchItem.dirty bits */
+#define DIRTY_SOURCE 1                /* an event named the source */
+#define DIRTY_DEP    2                /* an event named one of its includes */
+
+/* hash_file — two independent 32-bit hashes of the contents; 0 if unreadable */
+static int hash_file(const char *path, long *size, unsigned *ha, unsigned *hb)
+{
+    FILE *fp = fopen(path, "rb");
+    unsigned char buf[8192];
+    unsigned a = 2166136261u, b = 5381u;
+    size_t n, i;
+    long total = 0;
+
+    if (!fp) return 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        for (i = 0; i < n; ++i) {
+            a = (a ^ buf[i]) * 16777619u;   /* FNV-1a */
+            b = b * 33u + buf[i];           /* djb2 */
+        }
+        total += (long)n;
+    }
+    fclose(fp);
+    *size = total;
+    *ha = a;
+    *hb = b;
+    return 1;
+}
+
+/* watch_record — store settings plus the contents' fingerprint */
+void watch_record(WatchItem *item, const char *path, const MemoryModel *model,
+                  int jobs, int mem_stats, int extras, int max_errors, int pool_strings)
+{
+    strncpy(item->path, path, WATCH_PATH_LEN - 1);
+    item->path[WATCH_PATH_LEN - 1] = '\0';
+    item->model = model;
+    item->jobs = jobs;
+    item->mem_stats = mem_stats;
+    item->extras = extras;
+    item->max_errors = max_errors;
+    item->pool_strings = pool_strings;
+    item->ok = 0;
+    item->wd = -1;
+    inc_init(&item->inc);
+    item->dirty = 0;
+    item->deps = NULL;
+    item->dep_wd = NULL;
+    item->dep_count = 0;
+    if (!hash_file(path, &item->size, &item->hash_a, &item->hash_b)) {
+        item->size = -1;
+        item->hash_a = item->hash_b = 0;
+    }
+}
+
+/* split_path — directory part (or ".") and the base name */
+static const char *split_path(const char *path, char *dir, size_t dirsz)
+{
+    const char *slash = strrchr(path, '/');
+    size_t n;
+    if (!slash) { strcpy(dir, "."); return path; }
+    n = (slash == path) ? 1 : (size_t)(slash - path);
+    if (n >= dirsz) n = dirsz - 1;
+    memcpy(dir, path, n);
+    dir[n] = '\0';
+    return slash + 1;
+}
+
+/* free_deps — forget the include list of the last run */
+static void free_deps(WatchItem *item)
+{
+    int i;
+    for (i = 0; i < item->dep_count; ++i) free(item->deps[i]);
+    free(item->deps);
+    free(item->dep_wd);
+    item->deps = NULL;
+    item->dep_wd = NULL;
+    item->dep_count = 0;
+}
+
+/* watch_note_deps — copy the files the last run included (plain malloc:
+ * the list outlives the per-file allocator window) */
+void watch_note_deps(WatchItem *item)
+{
+    const char **paths;
+    int i, n = pre_assemble_deps(&paths);
+
+    free_deps(item);
+    if (n <= 0) return;
+    item->deps = (char **)malloc((size_t)n * sizeof(char *));
+    item->dep_wd = (int *)malloc((size_t)n * sizeof(int));
+    if (!item->deps || !item->dep_wd) {
+        free(item->deps);
+        free(item->dep_wd);
+        item->deps = NULL;
+        item->dep_wd = NULL;
+        return;
+    }
+    for (i = 0; i < n; ++i) {
+        item->deps[i] = (char *)malloc(strlen(paths[i]) + 1);
+        if (!item->deps[i]) break;
+        strcpy(item->deps[i], paths[i]);
+        item->dep_wd[i] = -1;
+    }
+    item->dep_count = i;
+}
+
+/* watch_release — free what an item holds */
+void watch_release(WatchItem *item)
+{
+    inc_free(&item->inc);
+    free_deps(item);
+}
+
+/* watch_dirs — watch the source's directory and each include's; inotify
+ * hands back the same descriptor for a directory already watched */
+static void watch_dirs(int fd, WatchItem *item)
+{
+    char dir[WATCH_PATH_LEN];
+    int i;
+
+    if (item->wd < 0) {
+        split_path(item->path, dir, sizeof(dir));
+        item->wd = inotify_add_watch(fd, dir, WATCH_EVENTS);
+        if (item->wd < 0) fprintf(stderr, "[error] --watch: cannot watch %s\n", dir);
+    }
+    for (i = 0; i < item->dep_count; ++i) {
+        split_path(item->deps[i], dir, sizeof(dir));
+        item->dep_wd[i] = inotify_add_watch(fd, dir, WATCH_EVENTS);
+        if (item->dep_wd[i] < 0) fprintf(stderr, "[error] --watch: cannot watch %s\n", dir);
+    }
+}
+
+/* refresh — reassemble one item if its contents differ from the last run
+ * or an include changed; 1 if it was reassembled */
+static int refresh(WatchItem *item)
+{
+    struct stat st;
+    long size;
+    unsigned ha, hb;
+    int dirty = item->dirty;
+
+    item->dirty = 0;
+    if (stat(item->path, &st) != 0) return 0;               /* mid-rename */
+    if (!hash_file(item->path, &size, &ha, &hb)) return 0;
+    if (!(dirty & DIRTY_DEP) &&
+        size == item->size && ha == item->hash_a && hb == item->hash_b) return 0;
+
+    item->size = size;
+    item->hash_a = ha;
+    item->hash_b = hb;
+    set_memory_model(item->model);
+    set_pass1_jobs(item->jobs);
+    set_pass2_jobs(item->jobs);
+    set_output_extras(item->extras);
+    set_max_errors(item->max_errors);
+    set_pool_strings(item->pool_strings);
+    item->ok = reassemble(item->path, item->mem_stats, &item->inc);
+    watch_note_deps(item);
+    printf("[watch] %s: %s\n", item->path, item->ok ? "ok" : "failed");
+    fflush(stdout);
+    return 1;
+}
+
+/* drain — read pending inotify events and mark the sources they name */
+static int drain(int fd, WatchItem *items, int count)
+{
+    char buf[4096];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    char *p;
+
+    if (n < 0) return errno == EINTR || errno == EAGAIN;
+    for (p = buf; p < buf + n; ) {
+        const struct inotify_event *ev = (const struct inotify_event *)p;
+        int i;
+        if (ev->len > 0) {
+            for (i = 0; i < count; ++i) {
+                char dir[WATCH_PATH_LEN];
+                int d;
+                if (items[i].wd == ev->wd &&
+                    strcmp(split_path(items[i].path, dir, sizeof(dir)), ev->name) == 0)
+                    items[i].dirty |= DIRTY_SOURCE;
+                for (d = 0; d < items[i].dep_count; ++d)
+                    if (items[i].dep_wd[d] == ev->wd &&
+                        strcmp(split_path(items[i].deps[d], dir, sizeof(dir)), ev->name) == 0)
+                        items[i].dirty |= DIRTY_DEP;
+            }
+        }
+        p += sizeof(struct inotify_event) + ev->len;
+    }
+    return 1;
+}
+
+/* watch_sources — block on inotify; after each burst, refresh dirty items */
+int watch_sources(WatchItem *items, int count)
+{
+    struct pollfd pfd;
+    int fd, i;
+
+    fd = inotify_init();
+    if (fd < 0) {
+        fprintf(stderr, "[error] --watch: inotify unavailable\n");
+        return 0;
+    }
+    /* watch directories, not files: editors often save by rename */
+    for (i = 0; i < count; ++i) watch_dirs(fd, &items[i]);
+    printf("[watch] watching %d file%s\n", count, count == 1 ? "" : "s");
+    fflush(stdout);
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for (;;) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (!drain(fd, items, count)) break;
+        /* debounce: keep absorbing events until the writer goes quiet */
+        while (poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0)
+            if (!drain(fd, items, count)) break;
+        /* a rebuild may have picked up new includes: watch them too */
+        for (i = 0; i < count; ++i)
+            if (items[i].dirty && refresh(&items[i])) watch_dirs(fd, &items[i]);
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/* xref.c
+ * Builds the .xref listing. Fixups are grouped per symbol in one pass, by
+ * the symbol id each one carries; groups keep fixup (slot) order, so the
+ * uses of each symbol come out sorted by address.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xref.h"
+#include "output_files.h"
+#include "alloc_stats.h"
+#include "pre_assembler.h"
+
+#define LOGICAL_BASE 100
+
+/* XrefEntry — one symbol and the chain of fixups that name it */
+typedef struct {
+    const Symbol *sym;
+    int first, last;                  /* fixup indexes; -1 when unused */
+} XrefEntry;
+
+/* by_name — qsort order for entries */
+static int by_name(const void *a, const void *b)
+{
+    return strcmp(((const XrefEntry *)a)->sym->name, ((const XrefEntry *)b)->sym->name);
+}
+
+/* line_text — where .am line am_line came from: its number in the source,
+ * or file:line for a line of an included file */
+static const char *line_text(const char *src, int am_line, char *buf, size_t bufsz)
+{
+    const char *file = src;
+    int line = am_line;
+
+    pre_assemble_origin(am_line, &file, &line);
+    if (strcmp(file, src) == 0 || strlen(file) + 12 > bufsz) sprintf(buf, "%d", line);
+    else sprintf(buf, "%s:%d", file, line);
+    return buf;
+}
+
+/* write_xref — the listing itself, entries already sorted */
+static void write_xref(FILE *fp, const char *src, const MemoryModel *mm, const MemoryImage *mem,
+                       const XrefEntry *entries, int count, const int *next)
+{
+    int i, k, width = 8;
+    char a4[16], ln[300];
+
+    for (i = 0; i < count; ++i) {
+        int n = (int)strlen(entries[i].sym->name);
+        if (n > width) width = n;
+    }
+    fprintf(fp, "%-*s %6s %6s  %-*s %s\n", width, "; symbol", "line", "addr",
+            mm->addr_digits, "b4", "type   flags");
+    for (i = 0; i < count; ++i) {
+        const Symbol *s = entries[i].sym;
+        const char *type = s->is_extern ? "extern" : s->type == SYMBOL_CODE ? "code" : "data";
+
+        line_text(src, s->line, ln, sizeof(ln));
+        if (s->is_extern) fprintf(fp, "%-*s %6s %6s  %-*s", width, s->name, ln, "-", mm->addr_digits, "-");
+        else {
+            to_base4_letters((unsigned)s->address, mm->addr_digits, a4);
+            fprintf(fp, "%-*s %6s %6d  %s", width, s->name, ln, s->address, a4);
+        }
+        if (s->is_entry) fprintf(fp, " %-6s entry\n", type);
+        else fprintf(fp, " %s\n", type);
+
+        for (k = entries[i].first; k >= 0; k = next[k]) {
+            int addr = LOGICAL_BASE + mem->fix_slot[k];
+            to_base4_letters((unsigned)addr, mm->addr_digits, a4);
+            fprintf(fp, "%-*s %6s %6d  %s\n", width, "    use",
+                    line_text(src, mem->fix_line[k], ln, sizeof(ln)), addr, a4);
+        }
+    }
+}
+
+/* write_xref_file — chain each fixup onto its symbol's entry, sort, print */
+void write_xref_file(const char *src_filename, const MemoryImage *mem, const Symbol *symbols)
+{
+    const MemoryModel *mm;
+    const Symbol *s;
+    XrefEntry *entries;
+    int *next;
+    int count = 0, k;
+    char path[300];
+    FILE *fp;
+
+    if (!src_filename || !mem) return;
+    mm = mem->model ? mem->model : default_memory_model();
+    for (s = symbols; s; s = s->next) count++;
+
+    entries = (XrefEntry *)as_malloc((size_t)(count + 1) * sizeof(XrefEntry));
+    next = (int *)as_malloc((size_t)(mem->fixup_count + 1) * sizeof(int));
+    if (!entries || !next) goto out;
+
+    /* entries[id] until sorted */
+    for (s = symbols; s; s = s->next) {
+        entries[s->id].sym = s;
+        entries[s->id].first = entries[s->id].last = -1;
+    }
+
+    /* one pass over the fixups: append each to its symbol's chain */
+    for (k = 0; k < mem->fixup_count; ++k) {
+        XrefEntry *e = &entries[mem->fix_sym[k]];
+        next[k] = -1;
+        if (e->last < 0) e->first = k; else next[e->last] = k;
+        e->last = k;
+    }
+
+    qsort(entries, (size_t)count, sizeof(XrefEntry), by_name);
+
+    output_path(src_filename, ".xref", path);
+    fp = fopen(path, "w");
+    if (!fp) goto out;
+    write_xref(fp, src_filename, mm, mem, entries, count, next);
+    fclose(fp);
+
+out:
+    as_free(entries);
+    as_free(next);
+}